@@ -143,6 +143,7 @@ main() {
     pushd $BUILD_PATH
     cmake -H.. -Bdebug -DCMAKE_EXPORT_COMPILE_COMMANDS=ON
     #cmake --build debug
+    cmake --build debug --target membench
     cmake --build debug --target qemu
     popd
 
@@ -1,17 +1,151 @@
 #include "amd64.hpp"
 #include "instructions.hpp"
 #include "bootstrap/segments.hpp"
+#include "fpu.hpp"
+#include "apic/ioapic.hpp"
+#include "apic/lapic.hpp"
+#include "percpu.hpp"
+#include "pmu.hpp"
+#include "smp.hpp"
+
+#include "libs/string.hpp"
+
+constexpr uint32_t CPUID_7_EBX_ERMS = 1u << 9;
+constexpr uint32_t CPUID_7_EDX_FSRM = 1u << 4;
+
+// picks the rep movsb/stosb paths of lib::memcpy and friends
+static void string_setup()
+{
+    uint32_t eax, ebx, ecx, edx;
+    insn::cpuid(0, 0, eax, ebx, ecx, edx);
+    if (eax < 7) {
+        return;
+    }
+
+    insn::cpuid(7, 0, eax, ebx, ecx, edx);
+    lib::string_setup((ebx & CPUID_7_EBX_ERMS) != 0, (edx & CPUID_7_EDX_FSRM) != 0);
+}
 
 amd64::amd64()
 {
+    string_setup();
     idt_setup();
-    gdt_setup();
+    gdt_setup(0);
     map_kernel_memory();
+    percpu::setup(0, 0);
+    tss_setup(0, percpu::get()->kernel_stack);
+    syscall_setup();
+    fpu::setup();
+    if (lapic::setup()) {
+        percpu::get()->apic_id = lapic::id();
+    }
+    pmu::setup();
+}
+
+bool amd64::register_interrupt(uint8_t vector, lib::interrupt_callback_t callback, void *context)
+{
+    if (!::register_interrupt(vector, callback, context)) {
+        return false;
+    }
+
+    // legacy lines stay masked at the IOAPIC until they have a handler
+    if (ioapic::enabled() && vector >= IRQ_BASE_VECTOR && vector < IRQ_BASE_VECTOR + 16) {
+        ioapic::unmask_irq(vector - IRQ_BASE_VECTOR);
+    }
+
+    return true;
+}
+
+bool amd64::unregister_interrupt(uint8_t vector, lib::interrupt_callback_t callback, void *context)
+{
+    if (!::unregister_interrupt(vector, callback, context)) {
+        return false;
+    }
+
+    if (ioapic::enabled() && vector >= IRQ_BASE_VECTOR && vector < IRQ_BASE_VECTOR + 16
+        && !has_interrupt_handler(vector)) {
+        ioapic::mask_irq(vector - IRQ_BASE_VECTOR);
+    }
+
+    return true;
+}
+
+bool amd64::route_interrupts(const acpi::madt_info *madt)
+{
+    if (!lapic::enabled() || !ioapic::setup(madt, IRQ_BASE_VECTOR, lapic::id())) {
+        return false;
+    }
+
+    // from now on the 8259s are silent and every EOI is a LAPIC MMIO write
+    pic_disable();
+    lapic::disable_virtual_wire();
+    set_legacy_pic(false);
+
+    // the IOAPIC starts with every line masked, reopen the ones that
+    // already have a driver
+    for (uint8_t irq = 0; irq < 16; irq++) {
+        if (has_interrupt_handler(IRQ_BASE_VECTOR + irq)) {
+            ioapic::unmask_irq(irq);
+        }
+    }
+
+    return true;
+}
+
+uint32_t amd64::start_cpus(const acpi::madt_info *madt, uint64_t tsc_hz)
+{
+    return smp::start(madt, tsc_hz);
+}
+
+uint64_t amd64::msi_address(uint32_t cpu) const
+{
+    // 0xfeexxxxx with the destination APIC id in bits 19:12, physical mode
+    constexpr uint64_t MSI_ADDRESS_BASE = 0xfee00000;
+
+    // a cpu that never came online has no APIC id to target
+    if (cpu >= smp::cpu_count()) {
+        return 0;
+    }
+
+    return MSI_ADDRESS_BASE | (static_cast<uint64_t>(percpu::get(cpu)->apic_id) << 12);
+}
+
+void amd64::set_keyboard_handler(const keyboard_handler_t *handler)
+{
+    constexpr uint8_t IRQ_KEYBOARD = 1;
+
+    register_interrupt(irq_vector(IRQ_KEYBOARD), lib::interrupt_trampoline<keyboard_handler_t>,
+                       const_cast<keyboard_handler_t*>(handler));
+}
+
+void amd64::set_timer_handler(const timer_handler_t *handler)
+{
+    constexpr uint8_t IRQ_TIMER = 0;
+
+    // ticks come from the LAPIC timer when it was set up, the PIT otherwise
+    auto vector = lapic::timer_enabled() ? lapic::TIMER_VECTOR : irq_vector(IRQ_TIMER);
+    register_interrupt(vector, lib::interrupt_trampoline<timer_handler_t>,
+                       const_cast<timer_handler_t*>(handler));
+}
+
+bool amd64::local_timer_setup(uint64_t tsc_hz)
+{
+    if (!lapic::timer_setup(tsc_hz)) {
+        return false;
+    }
+
+    // the LAPIC timer takes over, silence the PIT on the master 8259
+    constexpr uint16_t PIC1_DATA = 0x21;
+    constexpr uint8_t  IRQ_TIMER = 0x01;
+    insn::outb(PIC1_DATA, insn::inb(PIC1_DATA) | IRQ_TIMER);
+
+    return true;
 }
 
 void amd64::cpu_halt()
 {
-    insn::sti();
-    insn::hlt();
-    insn::cli();
+    // sti only takes effect after the next instruction, so an interrupt
+    // pending since the caller's last check can't be serviced before the
+    // hlt, it wakes it instead
+    asm volatile("sti; hlt; cli" : : : "memory");
 }
\ No newline at end of file
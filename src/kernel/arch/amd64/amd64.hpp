@@ -2,16 +2,21 @@
 #define AMD64_HPP
 
 #include "arch/iarch.hpp"
+#include "apic/lapic.hpp"
 #include "bootstrap/irq.hpp"
+#include "bootstrap/irq_stats.hpp"
 #include "instructions.hpp"
+#include "pmu.hpp"
 #include "memory/paging.hpp"
 #include "memory/pagetable.hpp"
+#include "video/framebuffer.hpp"
 #include "video/protected_mode.hpp"
 
 class amd64 : public iarch
 {
 private:
     protected_mode video_;
+    framebuffer framebuffer_;
     paging paging_;
 
 public:
@@ -19,19 +24,108 @@ public:
 
     void cpu_halt() override;
 
+    uint64_t irq_save() override
+    {
+        return insn::irq_save();
+    }
+
+    void irq_restore(uint64_t flags) override
+    {
+        insn::irq_restore(flags);
+    }
+
     iprotected_mode *get_video() override
     {
+        if (framebuffer_.enabled()) {
+            return &framebuffer_;
+        }
+
         return &video_;
     }
 
-    void set_keyboard_handler(const keyboard_handler_t *handler) override
+    bool setup_framebuffer(const multiboot_info *info) override
+    {
+        return framebuffer_.setup(info);
+    }
+
+    bool register_interrupt(uint8_t vector, lib::interrupt_callback_t callback, void *context) override;
+    bool unregister_interrupt(uint8_t vector, lib::interrupt_callback_t callback, void *context) override;
+
+    uint8_t irq_vector(uint8_t irq) const override
+    {
+        return IRQ_BASE_VECTOR + irq;
+    }
+
+    uint8_t allocate_vector() override
+    {
+        return ::allocate_vector();
+    }
+
+    bool route_interrupts(const acpi::madt_info *madt) override;
+
+    uint32_t start_cpus(const acpi::madt_info *madt, uint64_t tsc_hz) override;
+
+    uint64_t msi_address(uint32_t cpu) const override;
+
+    uint32_t msi_data(uint8_t vector) const override
+    {
+        // fixed delivery, edge triggered
+        return vector;
+    }
+
+    void print_interrupt_stats(iprotected_mode *video) override
+    {
+        irqstats::print(video);
+    }
+
+    void print_task_counters(iprotected_mode *video) override
+    {
+        pmu::print(video);
+    }
+
+    bool start_sampling(uint32_t period) override
+    {
+        return pmu::start_sampling(pmu::CYCLES, period);
+    }
+
+    void stop_sampling() override
+    {
+        pmu::stop_sampling();
+    }
+
+    bool sampling() const override
+    {
+        return pmu::sampling();
+    }
+
+    vaddr_t map_io(uintptr_t addr, size_t size) override
+    {
+        return paging_.mapio(addr, size, 0);
+    }
+
+    vaddr_t map_memory(uintptr_t addr, size_t size) override
+    {
+        return paging_.map_memory(addr, size);
+    }
+
+    void set_keyboard_handler(const keyboard_handler_t *handler) override;
+    void set_timer_handler(const timer_handler_t *handler) override;
+
+    bool local_timer_setup(uint64_t tsc_hz) override;
+
+    void local_timer_periodic(uint32_t frequency) override
+    {
+        lapic::timer_periodic(frequency);
+    }
+
+    void local_timer_oneshot(uint64_t nanosecs) override
     {
-        keyboard_handler_p = handler;
+        lapic::timer_oneshot(nanosecs);
     }
 
-    void set_timer_handler(const timer_handler_t *handler) override
+    void local_timer_stop() override
     {
-        timer_handler_p = handler;
+        lapic::timer_stop();
     }
 
     uint8_t read_byte(uint16_t value_port) const override
@@ -0,0 +1,158 @@
+#include "ioapic.hpp"
+
+#include "arch/amd64/memory/paging.hpp"
+#include "libs/logger.hpp"
+
+constexpr uint8_t ISA_IRQS = 16;
+
+// indirect register access: select in IOREGSEL, then read/write IOWIN
+constexpr size_t IOREGSEL = 0x00;
+constexpr size_t IOWIN    = 0x10;
+
+enum IOAPIC_REGISTER {
+    REG_ID          = 0x00,
+    REG_VERSION     = 0x01,
+    REG_REDIRECTION = 0x10  // two registers per entry
+};
+
+constexpr uint32_t REDIR_POLARITY_LOW = 1u << 13;
+constexpr uint32_t REDIR_TRIGGER_LEVEL = 1u << 15;
+constexpr uint32_t REDIR_MASKED       = 1u << 16;
+
+struct ioapic_t
+{
+    volatile uint32_t *base;
+    uint32_t gsi_base;
+    uint32_t gsi_count;
+};
+
+struct ioapic_context
+{
+    ioapic_t ioapics[acpi::MAX_IOAPICS];
+    uint32_t count;
+
+    // ISA irq -> GSI after the source overrides
+    uint32_t isa_gsi[ISA_IRQS];
+};
+
+static ioapic_context context_;
+
+static uint32_t read(const ioapic_t &ioapic, uint8_t reg)
+{
+    ioapic.base[IOREGSEL / sizeof(uint32_t)] = reg;
+    return ioapic.base[IOWIN / sizeof(uint32_t)];
+}
+
+static void write(const ioapic_t &ioapic, uint8_t reg, uint32_t value)
+{
+    ioapic.base[IOREGSEL / sizeof(uint32_t)] = reg;
+    ioapic.base[IOWIN / sizeof(uint32_t)] = value;
+}
+
+static ioapic_t *find(uint32_t gsi)
+{
+    for (uint32_t i = 0; i < context_.count; i++) {
+        auto &ioapic = context_.ioapics[i];
+        if (gsi >= ioapic.gsi_base && gsi < ioapic.gsi_base + ioapic.gsi_count) {
+            return &ioapic;
+        }
+    }
+
+    return nullptr;
+}
+
+static void set_mask(uint32_t gsi, bool masked)
+{
+    auto *ioapic = find(gsi);
+    if (ioapic == nullptr) {
+        return;
+    }
+
+    auto reg = static_cast<uint8_t>(REG_REDIRECTION + (gsi - ioapic->gsi_base) * 2);
+    auto low = read(*ioapic, reg);
+    write(*ioapic, reg, masked ? (low | REDIR_MASKED) : (low & ~REDIR_MASKED));
+}
+
+bool ioapic::setup(const acpi::madt_info *madt, uint8_t base_vector, uint8_t apic_id)
+{
+    if (madt == nullptr || madt->ioapic_count == 0) {
+        return false;
+    }
+
+    paging page_mgr;
+    for (uint32_t i = 0; i < madt->ioapic_count; i++) {
+        auto &ioapic = context_.ioapics[i];
+        ioapic.base = static_cast<volatile uint32_t*>(page_mgr.mapio(madt->ioapics[i].address, 0));
+        ioapic.gsi_base = madt->ioapics[i].gsi_base;
+        ioapic.gsi_count = ((read(ioapic, REG_VERSION) >> 16) & 0xff) + 1;
+
+        // nothing fires until a driver asks for it
+        for (uint32_t pin = 0; pin < ioapic.gsi_count; pin++) {
+            write(ioapic, static_cast<uint8_t>(REG_REDIRECTION + pin * 2), REDIR_MASKED);
+        }
+    }
+    context_.count = madt->ioapic_count;
+
+    for (uint8_t irq = 0; irq < ISA_IRQS; irq++) {
+        uint32_t gsi = irq;
+        uint16_t flags = 0;
+
+        for (uint32_t i = 0; i < madt->override_count; i++) {
+            if (madt->overrides[i].source == irq) {
+                gsi = madt->overrides[i].gsi;
+                flags = madt->overrides[i].flags;
+            }
+        }
+
+        context_.isa_gsi[irq] = gsi;
+        route(gsi, base_vector + irq, apic_id, flags);
+        set_mask(gsi, true);
+    }
+
+    lib::log(lib::log_level::INFO, "IOAPIC: legacy irqs routed");
+    return true;
+}
+
+bool ioapic::enabled()
+{
+    return context_.count != 0;
+}
+
+bool ioapic::route(uint32_t gsi, uint8_t vector, uint8_t apic_id, uint16_t flags)
+{
+    auto *ioapic = find(gsi);
+    if (ioapic == nullptr) {
+        return false;
+    }
+
+    // fixed delivery, physical destination; ISA defaults to active high,
+    // edge triggered unless the MPS flags say otherwise
+    uint32_t low = vector;
+    if ((flags & acpi::POLARITY_MASK) == acpi::POLARITY_LOW) {
+        low |= REDIR_POLARITY_LOW;
+    }
+    if ((flags & acpi::TRIGGER_MASK) == acpi::TRIGGER_LEVEL) {
+        low |= REDIR_TRIGGER_LEVEL;
+    }
+
+    auto reg = static_cast<uint8_t>(REG_REDIRECTION + (gsi - ioapic->gsi_base) * 2);
+    write(*ioapic, reg, REDIR_MASKED);
+    write(*ioapic, reg + 1, static_cast<uint32_t>(apic_id) << 24);
+    write(*ioapic, reg, low);
+
+    return true;
+}
+
+void ioapic::mask_irq(uint8_t irq)
+{
+    if (irq < ISA_IRQS) {
+        set_mask(context_.isa_gsi[irq], true);
+    }
+}
+
+void ioapic::unmask_irq(uint8_t irq)
+{
+    if (irq < ISA_IRQS) {
+        set_mask(context_.isa_gsi[irq], false);
+    }
+}
\ No newline at end of file
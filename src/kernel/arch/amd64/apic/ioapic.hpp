@@ -0,0 +1,31 @@
+#ifndef IOAPIC_HPP
+#define IOAPIC_HPP
+
+#include "libs/stdint.hpp"
+#include "drivers/acpi/acpi.hpp"
+
+/*
+ * I/O APIC
+ *
+ * Replaces the 8259 pair for external interrupts. Every global system
+ * interrupt (GSI) has a redirection entry holding the vector, the target
+ * LAPIC and the pin polarity/trigger mode. ISA irqs are identity mapped to
+ * GSIs unless the MADT carries an interrupt source override (the PIT is
+ * usually wired to GSI 2, for example).
+ *
+ * setup() programs the 16 ISA irqs to vectors base..base+15, all masked;
+ * a line is unmasked once somebody registers a handler for it.
+ */
+namespace ioapic
+{
+    bool setup(const acpi::madt_info *madt, uint8_t base_vector, uint8_t apic_id);
+    bool enabled();
+
+    bool route(uint32_t gsi, uint8_t vector, uint8_t apic_id, uint16_t flags);
+
+    // ISA irq, translated through the source overrides
+    void mask_irq(uint8_t irq);
+    void unmask_irq(uint8_t irq);
+}
+
+#endif // IOAPIC_HPP
\ No newline at end of file
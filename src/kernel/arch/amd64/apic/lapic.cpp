@@ -0,0 +1,272 @@
+#include "lapic.hpp"
+
+#include "arch/amd64/instructions.hpp"
+#include "arch/amd64/memory/paging.hpp"
+#include "libs/logger.hpp"
+
+constexpr uint32_t MSR_APIC_BASE     = 0x1b;
+constexpr uint32_t MSR_TSC_DEADLINE  = 0x6e0;
+
+constexpr uint64_t APIC_BASE_ENABLE  = 1ull << 11;
+constexpr uint64_t APIC_BASE_MASK    = 0xffffff000ull;
+
+constexpr uint32_t CPUID_1_EDX_APIC         = 1u << 9;
+constexpr uint32_t CPUID_1_ECX_TSC_DEADLINE = 1u << 24;
+
+// register offsets from the LAPIC base
+enum LAPIC_REGISTER {
+    REG_ID            = 0x020,
+    REG_VERSION       = 0x030,
+    REG_TPR           = 0x080,
+    REG_EOI           = 0x0b0,
+    REG_SVR           = 0x0f0,
+    REG_ICR_LOW       = 0x300,
+    REG_ICR_HIGH      = 0x310,
+    REG_LVT_TIMER     = 0x320,
+    REG_LVT_PERF      = 0x340,
+    REG_LVT_LINT0     = 0x350,
+    REG_LVT_LINT1     = 0x360,
+    REG_LVT_ERROR     = 0x370,
+    REG_TIMER_INITIAL = 0x380,
+    REG_TIMER_CURRENT = 0x390,
+    REG_TIMER_DIVIDE  = 0x3e0
+};
+
+constexpr uint32_t SVR_ENABLE          = 1u << 8;
+
+constexpr uint32_t LVT_MASKED          = 1u << 16;
+constexpr uint32_t LVT_DELIVERY_NMI    = 0x4u << 8;
+constexpr uint32_t LVT_DELIVERY_EXTINT = 0x7u << 8;
+
+constexpr uint32_t ICR_INIT            = 0x5u << 8;
+constexpr uint32_t ICR_STARTUP         = 0x6u << 8;
+constexpr uint32_t ICR_PENDING         = 1u << 12;  // delivery status
+constexpr uint32_t ICR_ASSERT          = 1u << 14;
+constexpr uint32_t ICR_LEVEL           = 1u << 15;
+
+constexpr uint32_t TIMER_ONESHOT       = 0x0u << 17;
+constexpr uint32_t TIMER_PERIODIC      = 0x1u << 17;
+constexpr uint32_t TIMER_TSC_DEADLINE  = 0x2u << 17;
+
+constexpr uint32_t TIMER_DIVIDE_16     = 0x3;
+
+// how long the timer count rate is measured for
+constexpr uint64_t CALIBRATION_MS      = 10;
+
+constexpr uint64_t NANOSECS_PER_SEC    = 1'000'000'000ull;
+
+struct lapic_context
+{
+    volatile uint32_t *base;
+
+    uint64_t tsc_hz;
+    uint64_t timer_hz;      // count register decrements per second
+    bool     tsc_deadline;
+};
+
+static lapic_context context_;
+
+static uint32_t read(LAPIC_REGISTER reg)
+{
+    return context_.base[reg / sizeof(uint32_t)];
+}
+
+static void write(LAPIC_REGISTER reg, uint32_t value)
+{
+    context_.base[reg / sizeof(uint32_t)] = value;
+}
+
+// converts without overflowing for long intervals
+static uint64_t scale(uint64_t nanosecs, uint64_t hz)
+{
+    return (nanosecs / NANOSECS_PER_SEC) * hz
+         + ((nanosecs % NANOSECS_PER_SEC) * hz) / NANOSECS_PER_SEC;
+}
+
+bool lapic::setup()
+{
+    uint32_t eax, ebx, ecx, edx;
+    insn::cpuid(1, 0, eax, ebx, ecx, edx);
+
+    if ((edx & CPUID_1_EDX_APIC) == 0) {
+        lib::log(lib::log_level::WARNING, "LAPIC: not present");
+        return false;
+    }
+
+    context_.tsc_deadline = (ecx & CPUID_1_ECX_TSC_DEADLINE) != 0;
+
+    auto apic_base = insn::rdmsr(MSR_APIC_BASE);
+    insn::wrmsr(MSR_APIC_BASE, apic_base | APIC_BASE_ENABLE);
+
+    paging page_mgr;
+    context_.base = static_cast<volatile uint32_t*>(page_mgr.mapio(apic_base & APIC_BASE_MASK, 0));
+
+    // virtual wire mode: 8259 interrupts come in through LINT0, NMI on LINT1
+    write(REG_LVT_LINT0, LVT_DELIVERY_EXTINT);
+    write(REG_LVT_LINT1, LVT_DELIVERY_NMI);
+    write(REG_LVT_ERROR, LVT_MASKED);
+    write(REG_LVT_TIMER, LVT_MASKED);
+
+    // accept every priority and software enable the LAPIC
+    write(REG_TPR, 0);
+    write(REG_SVR, SVR_ENABLE | lapic::SPURIOUS_VECTOR);
+    write(REG_EOI, 0);
+
+    lib::log(lib::log_level::INFO, "LAPIC: enabled in virtual wire mode");
+    return true;
+}
+
+void lapic::setup_ap()
+{
+    insn::wrmsr(MSR_APIC_BASE, insn::rdmsr(MSR_APIC_BASE) | APIC_BASE_ENABLE);
+
+    write(REG_LVT_LINT0, LVT_MASKED);
+    write(REG_LVT_LINT1, LVT_DELIVERY_NMI);
+    write(REG_LVT_ERROR, LVT_MASKED);
+    write(REG_LVT_TIMER, LVT_MASKED);
+    write(REG_LVT_PERF, LVT_MASKED);
+
+    write(REG_TPR, 0);
+    write(REG_SVR, SVR_ENABLE | lapic::SPURIOUS_VECTOR);
+    write(REG_EOI, 0);
+}
+
+bool lapic::enabled()
+{
+    return context_.base != nullptr;
+}
+
+uint32_t lapic::id()
+{
+    return read(REG_ID) >> 24;
+}
+
+void lapic::eoi()
+{
+    write(REG_EOI, 0);
+}
+
+void lapic::disable_virtual_wire()
+{
+    write(REG_LVT_LINT0, LVT_MASKED | LVT_DELIVERY_EXTINT);
+}
+
+bool lapic::timer_setup(uint64_t tsc_hz)
+{
+    if (!enabled() || tsc_hz == 0) {
+        return false;
+    }
+
+    context_.tsc_hz = tsc_hz;
+
+    // let the counter run masked from its maximum value for CALIBRATION_MS,
+    // measured with the TSC, to find out how fast it decrements
+    write(REG_TIMER_DIVIDE, TIMER_DIVIDE_16);
+    write(REG_LVT_TIMER, LVT_MASKED | TIMER_ONESHOT | lapic::TIMER_VECTOR);
+    write(REG_TIMER_INITIAL, 0xffffffff);
+
+    auto wait = tsc_hz / (1000 / CALIBRATION_MS);
+    auto start = insn::rdtsc();
+    while (insn::rdtsc() - start < wait) {
+        insn::pause();
+    }
+
+    auto elapsed = 0xffffffff - read(REG_TIMER_CURRENT);
+    write(REG_TIMER_INITIAL, 0);
+
+    context_.timer_hz = static_cast<uint64_t>(elapsed) * (1000 / CALIBRATION_MS);
+    if (context_.timer_hz == 0) {
+        lib::log(lib::log_level::WARNING, "LAPIC: timer calibration failed");
+        return false;
+    }
+
+    return true;
+}
+
+bool lapic::has_tsc_deadline()
+{
+    return context_.tsc_deadline;
+}
+
+bool lapic::timer_enabled()
+{
+    return context_.timer_hz != 0;
+}
+
+void lapic::timer_periodic(uint32_t frequency)
+{
+    auto count = context_.timer_hz / frequency;
+    if (count == 0) {
+        count = 1;
+    }
+
+    write(REG_TIMER_DIVIDE, TIMER_DIVIDE_16);
+    write(REG_LVT_TIMER, TIMER_PERIODIC | lapic::TIMER_VECTOR);
+    write(REG_TIMER_INITIAL, static_cast<uint32_t>(count));
+}
+
+void lapic::timer_oneshot(uint64_t nanosecs)
+{
+    if (context_.tsc_deadline) {
+        write(REG_LVT_TIMER, TIMER_TSC_DEADLINE | lapic::TIMER_VECTOR);
+
+        // the LVT write must be visible before the deadline is armed
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        insn::wrmsr(MSR_TSC_DEADLINE, insn::rdtsc() + scale(nanosecs, context_.tsc_hz));
+        return;
+    }
+
+    auto count = scale(nanosecs, context_.timer_hz);
+    if (count == 0) {
+        count = 1;
+    }
+    else if (count > 0xffffffff) {
+        count = 0xffffffff;
+    }
+
+    write(REG_TIMER_DIVIDE, TIMER_DIVIDE_16);
+    write(REG_LVT_TIMER, TIMER_ONESHOT | lapic::TIMER_VECTOR);
+    write(REG_TIMER_INITIAL, static_cast<uint32_t>(count));
+}
+
+void lapic::timer_stop()
+{
+    if (context_.tsc_deadline) {
+        insn::wrmsr(MSR_TSC_DEADLINE, 0);
+    }
+
+    write(REG_LVT_TIMER, LVT_MASKED | lapic::TIMER_VECTOR);
+    write(REG_TIMER_INITIAL, 0);
+}
+
+void lapic::perf_interrupt(uint8_t vector)
+{
+    write(REG_LVT_PERF, vector);
+}
+
+void lapic::perf_mask()
+{
+    write(REG_LVT_PERF, read(REG_LVT_PERF) | LVT_MASKED);
+}
+
+static void send_ipi(uint32_t apic_id, uint32_t command)
+{
+    // the destination goes first, writing the low half sends the IPI
+    write(REG_ICR_HIGH, apic_id << 24);
+    write(REG_ICR_LOW, command);
+
+    while (read(REG_ICR_LOW) & ICR_PENDING) {
+        insn::pause();
+    }
+}
+
+void lapic::send_init(uint32_t apic_id)
+{
+    send_ipi(apic_id, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+    send_ipi(apic_id, ICR_INIT | ICR_LEVEL);
+}
+
+void lapic::send_startup(uint32_t apic_id, uint8_t page)
+{
+    send_ipi(apic_id, ICR_STARTUP | ICR_ASSERT | page);
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef LAPIC_HPP
+#define LAPIC_HPP
+
+#include "libs/stdint.hpp"
+
+/*
+ * Local APIC
+ *
+ * The LAPIC is enabled in virtual wire mode: LINT0 is programmed as ExtINT
+ * so the 8259 pair keeps delivering the legacy IRQs through it, while the
+ * LAPIC timer and the spurious vector are handled locally and acknowledged
+ * with eoi().
+ *
+ * The timer runs in one of two modes:
+ *   - TSC-deadline (CPUID.01h:ECX[24]): the interrupt fires when the TSC
+ *     reaches IA32_TSC_DEADLINE, so a deadline costs one wrmsr and has TSC
+ *     resolution
+ *   - one-shot/periodic: the current count register decrements at the bus
+ *     clock divided by 16, its rate is measured against the calibrated TSC
+ */
+namespace lapic
+{
+    constexpr uint8_t TIMER_VECTOR    = 0x30;
+    constexpr uint8_t SPURIOUS_VECTOR = 0xff;
+
+    bool setup();
+    bool enabled();
+
+    // application processors: LINT0 stays masked, the 8259s only reach
+    // the BSP. Uses the mapping setup() made, every cpu sees its own LAPIC
+    // at the same address.
+    void setup_ap();
+
+    uint32_t id();
+    void eoi();
+
+    // the IOAPIC took over, stop accepting ExtINT from the 8259s on LINT0
+    void disable_virtual_wire();
+
+    bool timer_setup(uint64_t tsc_hz);
+    bool has_tsc_deadline();
+    bool timer_enabled();
+
+    void timer_periodic(uint32_t frequency);
+    void timer_oneshot(uint64_t nanosecs);
+    void timer_stop();
+
+    // performance counter overflow (LVT PMC), delivery masks the entry
+    // again so the handler must call perf_interrupt() to re-arm it
+    void perf_interrupt(uint8_t vector);
+    void perf_mask();
+
+    // interprocessor messages that start an AP, page is the 4K aligned
+    // real mode entry point >> 12 (see arch/amd64/smp.hpp)
+    void send_init(uint32_t apic_id);
+    void send_startup(uint32_t apic_id, uint8_t page);
+}
+
+#endif // LAPIC_HPP
\ No newline at end of file
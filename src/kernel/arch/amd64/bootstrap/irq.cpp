@@ -1,10 +1,16 @@
 #include "irq.hpp"
 
+#include "arch/amd64/apic/lapic.hpp"
 #include "arch/amd64/instructions.hpp"
-#include "arch/amd64/video/protected_mode.hpp"
+#include "irq_stats.hpp"
+#include "task/softirq.hpp"
+#include "libs/logger.hpp"
 
-const timer_handler_t *timer_handler_p = nullptr;
-const keyboard_handler_t *keyboard_handler_p = nullptr;
+constexpr size_t INTERRUPT_VECTORS  = 256;
+
+// handler entries shared by all vectors, drivers register at boot time and
+// rarely go away so a small static pool is enough
+constexpr size_t INTERRUPT_HANDLERS = 64;
 
 enum PIC_CONTROLLER {
     PIC_MASTER = 0x20,
@@ -12,70 +18,165 @@ enum PIC_CONTROLLER {
 };
 
 enum PIC_COMMAND {
-    PIC_EOI = 0x20,
-    PIC_INIT = 0x11,
-    PIC_ICW1 = 0x01,
-    PIC_ICW4 = 0x01
+    PIC_EOI = 0x20
+};
+
+enum PIC_VECTOR {
+    PIC_MASTER_FIRST = 0x20,
+    PIC_SLAVE_FIRST  = 0x28,
+    PIC_SLAVE_LAST   = 0x2F
 };
 
-enum PIC_IRQ {
-    IRQ_TIMER = 0x20,
-    IRQ_KEYBOARD = 0x21,
-    IRQ_SERIAL1 = 0x23,
-    IRQ_SERIAL2 = 0x24,
-    IRQ_FLOPPY = 0x26,
-    IRQ_PARALLEL = 0x27,
-    IRQ_MOUSE = 0x2C,
-    IRQ_IDE1 = 0x2E,
-    IRQ_IDE2 = 0x2F
+struct handler_entry
+{
+    lib::interrupt_callback_t callback;
+    void *context;
+    handler_entry *next;
 };
 
-void interrupt_handler(const interrupt_t &interrupt)
+static handler_entry *vectors_[INTERRUPT_VECTORS];
+
+static bool legacy_pic_ = true;
+static uint8_t next_vector_ = DYNAMIC_FIRST_VECTOR;
+
+static handler_entry pool_[INTERRUPT_HANDLERS];
+static handler_entry *free_ = nullptr;
+static size_t pool_used_ = 0;
+
+static handler_entry *alloc_entry()
 {
-    // Send end-of-interrupt (EOI) signal to the slave PIC controller (if the interrupt
-    // is from a slave PIC)
-    if (interrupt.int_no >= 0x28) {
-        insn::outb(PIC_CONTROLLER::PIC_SLAVE, PIC_COMMAND::PIC_EOI);
+    if (free_ != nullptr) {
+        auto *entry = free_;
+        free_ = entry->next;
+        return entry;
     }
 
-    // Send end-of-interrupt (EOI) signal to the master PIC controller
-    insn::outb(PIC_CONTROLLER::PIC_MASTER, PIC_COMMAND::PIC_EOI);
+    if (pool_used_ < INTERRUPT_HANDLERS) {
+        return &pool_[pool_used_++];
+    }
 
-    switch (interrupt.int_no) {
-        case PIC_IRQ::IRQ_TIMER:
-            if (timer_handler_p != nullptr) {
-                (*timer_handler_p)(interrupt);
-            }
-            break;
+    return nullptr;
+}
 
-        case PIC_IRQ::IRQ_KEYBOARD:
-            if (keyboard_handler_p != nullptr) {
-                (*keyboard_handler_p)(interrupt);
-            }
-            break;
+static void free_entry(handler_entry *entry)
+{
+    entry->next = free_;
+    free_ = entry;
+}
 
-        case PIC_IRQ::IRQ_SERIAL1:
-            break;
+static void acknowledge(uint64_t vector)
+{
+    // CPU exceptions don't come from an interrupt controller and spurious
+    // interrupts must not be acknowledged
+    if (vector < PIC_VECTOR::PIC_MASTER_FIRST || vector == lapic::SPURIOUS_VECTOR) {
+        return;
+    }
 
-        case PIC_IRQ::IRQ_SERIAL2:
-            break;
+    if (legacy_pic_ && vector <= PIC_VECTOR::PIC_SLAVE_LAST) {
+        // Send end-of-interrupt (EOI) signal to the slave PIC controller (if the interrupt
+        // is from a slave PIC)
+        if (vector >= PIC_VECTOR::PIC_SLAVE_FIRST) {
+            insn::outb(PIC_CONTROLLER::PIC_SLAVE, PIC_COMMAND::PIC_EOI);
+        }
 
-        case PIC_IRQ::IRQ_FLOPPY:
-            break;
+        // Send end-of-interrupt (EOI) signal to the master PIC controller
+        insn::outb(PIC_CONTROLLER::PIC_MASTER, PIC_COMMAND::PIC_EOI);
+        return;
+    }
 
-        case PIC_IRQ::IRQ_PARALLEL:
-            break;
+    lapic::eoi();
+}
 
-        case PIC_IRQ::IRQ_MOUSE:
-            break;
+bool register_interrupt(uint8_t vector, lib::interrupt_callback_t callback, void *context)
+{
+    if (callback == nullptr) {
+        return false;
+    }
 
-        case PIC_IRQ::IRQ_IDE1:
-            break;
+    auto flags = insn::irq_save();
 
-        case PIC_IRQ::IRQ_IDE2:
-            break;
+    auto *entry = alloc_entry();
+    if (entry == nullptr) {
+        insn::irq_restore(flags);
+        lib::log(lib::log_level::ERROR, "IRQ: out of handler entries");
+        return false;
+    }
+
+    // append, handlers of a shared vector run in registration order
+    entry->callback = callback;
+    entry->context = context;
+    entry->next = nullptr;
 
-        default:
+    auto **tail = &vectors_[vector];
+    while (*tail != nullptr) {
+        tail = &(*tail)->next;
+    }
+    *tail = entry;
+
+    insn::irq_restore(flags);
+    return true;
+}
+
+bool unregister_interrupt(uint8_t vector, lib::interrupt_callback_t callback, void *context)
+{
+    auto flags = insn::irq_save();
+
+    for (auto **link = &vectors_[vector]; *link != nullptr; link = &(*link)->next) {
+        auto *entry = *link;
+        if (entry->callback == callback && entry->context == context) {
+            *link = entry->next;
+            free_entry(entry);
+
+            insn::irq_restore(flags);
+            return true;
+        }
+    }
+
+    insn::irq_restore(flags);
+    return false;
+}
+
+bool has_interrupt_handler(uint8_t vector)
+{
+    return vectors_[vector] != nullptr;
+}
+
+uint8_t allocate_vector()
+{
+    auto flags = insn::irq_save();
+
+    uint8_t vector = 0;
+    while (next_vector_ <= DYNAMIC_LAST_VECTOR) {
+        auto candidate = next_vector_++;
+        if (vectors_[candidate] == nullptr) {
+            vector = candidate;
             break;
+        }
+    }
+
+    insn::irq_restore(flags);
+    return vector;
+}
+
+void set_legacy_pic(bool enabled)
+{
+    legacy_pic_ = enabled;
+}
+
+void interrupt_handler(const interrupt_t &interrupt, uint64_t entry_tsc)
+{
+    auto vector = interrupt.int_no & 0xff;
+
+    acknowledge(vector);
+
+    for (auto *entry = vectors_[vector]; entry != nullptr; entry = entry->next) {
+        entry->callback(interrupt, entry->context);
+    }
+
+    irqstats::record(static_cast<uint8_t>(vector), entry_tsc, insn::rdtsc());
+
+    // bottom halves raised by the handlers, exceptions don't defer work
+    if (vector >= IRQ_BASE_VECTOR) {
+        softirq::irq_exit();
     }
 }
\ No newline at end of file
@@ -1,13 +1,38 @@
 #ifndef IRQ_HPP
 #define IRQ_HPP
 
-#include "drivers/peripherals/timer.hpp"
-#include "drivers/peripherals/keyboard.hpp"
+#include "libs/functional.hpp"
 #include "arch/amd64/registers.hpp"
 
-extern const timer_handler_t *timer_handler_p;
-extern const keyboard_handler_t *keyboard_handler_p;
+/*
+ * Vectored interrupt dispatch
+ *
+ * Every IDT vector owns a chain of (callback, context) pairs. The assembly
+ * stubs push the vector number and interrupt_handler() walks that vector's
+ * chain, so dispatch cost doesn't depend on how many drivers exist. Shared
+ * lines simply get more than one entry, all of them are called.
+ *
+ * Acknowledging the interrupt controller is done here before the chain
+ * runs, handlers never send EOIs themselves.
+ */
+constexpr uint8_t IRQ_BASE_VECTOR = 0x20; // legacy IRQ 0 after the 8259 remap
 
-void interrupt_handler(const interrupt_t &interrupt);
+// vectors handed out to MSI/MSI-X capable devices
+constexpr uint8_t DYNAMIC_FIRST_VECTOR = 0x40;
+constexpr uint8_t DYNAMIC_LAST_VECTOR  = 0xef;
+
+bool register_interrupt(uint8_t vector, lib::interrupt_callback_t callback, void *context);
+bool unregister_interrupt(uint8_t vector, lib::interrupt_callback_t callback, void *context);
+
+bool has_interrupt_handler(uint8_t vector);
+
+// returns a vector without handlers from the dynamic range, 0 if exhausted
+uint8_t allocate_vector();
+
+// with the legacy PICs gone every external interrupt is acknowledged at the LAPIC
+void set_legacy_pic(bool enabled);
+
+// entry_tsc is sampled by the assembly stub, see irq_stats.hpp
+void interrupt_handler(const interrupt_t &interrupt, uint64_t entry_tsc);
 
 #endif // IRQ_HPP
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "irq_stats.hpp"
+
+#include "arch/amd64/percpu.hpp"
+#include "arch/iprotected_mode.hpp"
+#include "config.hpp"
+#include "libs/string.hpp"
+#include "memory/allocators.hpp"
+
+static uint32_t bucket(uint64_t cycles)
+{
+    if (cycles == 0) {
+        return 0;
+    }
+
+    uint32_t log2 = 63 - __builtin_clzll(cycles);
+    return (log2 < irqstats::LATENCY_BUCKETS) ? log2 : irqstats::LATENCY_BUCKETS - 1;
+}
+
+irqstats::cpu_stats *irqstats::create()
+{
+    auto *stats = static_cast<cpu_stats*>(placement_kalloc(sizeof(cpu_stats), true));
+    lib::memset(stats, 0, sizeof(cpu_stats));
+
+    return stats;
+}
+
+void irqstats::record(uint8_t vector, uint64_t entry_tsc, uint64_t exit_tsc)
+{
+    auto *stats = percpu::get()->irq_stats;
+    if (stats == nullptr) {
+        return;
+    }
+
+    auto cycles = exit_tsc - entry_tsc;
+    auto &entry = stats->vectors[vector];
+
+    entry.count++;
+    entry.cycles += cycles;
+    if (cycles > entry.max_cycles) {
+        entry.max_cycles = cycles;
+    }
+    entry.latency[bucket(cycles)]++;
+}
+
+const irqstats::vector_stats *irqstats::get(uint32_t cpu, uint8_t vector)
+{
+    auto *block = percpu::get(cpu);
+    if (block == nullptr || block->irq_stats == nullptr) {
+        return nullptr;
+    }
+
+    return &block->irq_stats->vectors[vector];
+}
+
+irqstats::vector_stats irqstats::total(uint8_t vector)
+{
+    vector_stats sum;
+    lib::memset(&sum, 0, sizeof(sum));
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        auto *stats = get(cpu, vector);
+        if (stats == nullptr) {
+            continue;
+        }
+
+        sum.count += stats->count;
+        sum.cycles += stats->cycles;
+        if (stats->max_cycles > sum.max_cycles) {
+            sum.max_cycles = stats->max_cycles;
+        }
+
+        for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+            sum.latency[i] += stats->latency[i];
+        }
+    }
+
+    return sum;
+}
+
+void irqstats::reset()
+{
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        auto *block = percpu::get(cpu);
+        if (block != nullptr && block->irq_stats != nullptr) {
+            lib::memset(block->irq_stats, 0, sizeof(cpu_stats));
+        }
+    }
+}
+
+// one line per vector that fired:
+//   vec 0x20  count 1234  avg 812  max 9021  | 2^9:1100 2^10:130 2^13:4
+void irqstats::print(iprotected_mode *video)
+{
+    video->prints("Interrupt statistics (cycles)\n");
+
+    for (size_t vector = 0; vector < VECTORS; vector++) {
+        auto stats = total(static_cast<uint8_t>(vector));
+        if (stats.count == 0) {
+            continue;
+        }
+
+        video->format("vec {:p}  count {}  avg {}  max {}  |",
+                      vector, stats.count, stats.cycles / stats.count, stats.max_cycles);
+
+        for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+            if (stats.latency[i] != 0) {
+                video->format(" 2^{}:{}", i, stats.latency[i]);
+            }
+        }
+        video->printc('\n');
+    }
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef IRQ_STATS_HPP
+#define IRQ_STATS_HPP
+
+#include "libs/stdint.hpp"
+
+class iprotected_mode;
+
+/*
+ * Interrupt statistics
+ *
+ * The assembly stubs sample the TSC right after saving the registers and
+ * the dispatcher records, per cpu and per vector, how many times the vector
+ * fired and how many cycles its handlers took. Latencies also go into a
+ * log2 histogram: bucket n counts the interrupts that took [2^n, 2^(n+1))
+ * cycles, the last bucket catches everything slower.
+ *
+ * Each cpu only ever writes its own block, so recording needs no locking;
+ * readers may observe a count and a histogram that are one event apart.
+ */
+namespace irqstats
+{
+    constexpr size_t VECTORS         = 256;
+    constexpr size_t LATENCY_BUCKETS = 24;
+
+    struct vector_stats
+    {
+        uint64_t count;
+        uint64_t cycles;        // total time spent in the handlers
+        uint64_t max_cycles;
+        uint32_t latency[LATENCY_BUCKETS];
+    };
+
+    struct cpu_stats
+    {
+        vector_stats vectors[VECTORS];
+    };
+
+    // allocates the block of a cpu, called once by percpu::setup()
+    cpu_stats *create();
+
+    void record(uint8_t vector, uint64_t entry_tsc, uint64_t exit_tsc);
+
+    // nullptr when the cpu has no block yet
+    const vector_stats *get(uint32_t cpu, uint8_t vector);
+
+    // sum of every cpu
+    vector_stats total(uint8_t vector);
+
+    void reset();
+
+    void print(iprotected_mode *video);
+}
+
+#endif // IRQ_STATS_HPP
\ No newline at end of file
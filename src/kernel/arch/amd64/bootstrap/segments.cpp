@@ -1,14 +1,37 @@
 #include "segments.hpp"
 
+#include "config.hpp"
 #include "arch/amd64/instructions.hpp"
+#include "arch/amd64/percpu.hpp"
 #include "libs/logger.hpp"
+#include "libs/string.hpp"
 
 
 /*
  * Constants
  */
-const uint8_t LONG_MODE_GDT_GATES     =  7;
-const uint8_t LONG_MODE_IDT_GATES     = 64;
+const uint8_t  LONG_MODE_GDT_GATES     =   7;
+const uint16_t LONG_MODE_IDT_GATES     = 256;
+
+// external interrupt stubs generated in isr.S
+const uint16_t IRQ_FIRST_VECTOR        = 0x20;
+const size_t   IRQ_STUB_SIZE           = 16;
+
+// selectors, SYSRET requires user data right before user code
+const uint16_t KERNEL_CODE_SELECTOR   = 0x08;
+const uint16_t USER_BASE_SELECTOR     = 0x10; // SYSRET: SS = base + 8, CS = base + 16
+const uint16_t TSS_SELECTOR           = 0x28;
+
+// MSRs used by SYSCALL/SYSRET
+const uint32_t MSR_EFER   = 0xc0000080;
+const uint32_t MSR_STAR   = 0xc0000081; // segment selectors
+const uint32_t MSR_LSTAR  = 0xc0000082; // 64-bit entry point
+const uint32_t MSR_FMASK  = 0xc0000084; // rflags bits cleared on entry
+
+const uint64_t EFER_SCE   = 1ull << 0;  // syscall enable
+
+// IF, TF, DF and AC are cleared when entering the kernel
+const uint64_t SYSCALL_RFLAGS_MASK = (1ull << 9) | (1ull << 8) | (1ull << 10) | (1ull << 18);
 
 
 /*
@@ -101,6 +124,18 @@ struct gdt_entry
     uint64_t entry;
 } __attribute__((packed));
 
+// 64-bit TSS, only the stack pointers are used in long mode
+struct tss_entry
+{
+    uint32_t reserved_0;
+    uint64_t rsp[3];        // stack loaded on a privilege change to ring 0-2
+    uint64_t reserved_1;
+    uint64_t ist[7];        // interrupt stack table
+    uint64_t reserved_2;
+    uint16_t reserved_3;
+    uint16_t iomap_base;    // past the limit: no I/O permission bitmap
+} __attribute__((packed));
+
 struct gdt_ptr
 {
     uint16_t limit;
@@ -120,15 +155,18 @@ extern "C"
     void gdt_reload(gdt_ptr *);
 }
 
-gdt_entry g_entries[LONG_MODE_GDT_GATES];
+gdt_entry g_entries[MAX_CPUS][LONG_MODE_GDT_GATES];
+tss_entry t_entries[MAX_CPUS];
 idt_entry i_entries[LONG_MODE_IDT_GATES];
 
 
 /*
  * Implementations
  */
-void gdt_setup()
+void gdt_setup(uint32_t cpu)
 {
+    auto *entries = g_entries[cpu];
+
     gdt_ptr gdt;
     gdt_code_entry code;
     gdt_data_entry data;
@@ -175,43 +213,62 @@ void gdt_setup()
     user_data.fields.present      = 0x1;
     user_data.fields.ign_3        = 0x0;
 
-    g_entries[0].entry = 0;
-    g_entries[1].entry = code.ulong;      // Kernel code (0x08)
-    g_entries[2].entry = data.ulong;      // Kernel data (0x10)
-    g_entries[3].entry = user_code.ulong; // User code (0x18 | 3 = 0x1B)
-    g_entries[4].entry = user_data.ulong; // User data (0x20 | 3 = 0x23)
-    g_entries[5].entry = 0; // TSS low
-    g_entries[6].entry = 0; // TSS high
+    entries[0].entry = 0;
+    entries[1].entry = code.ulong;      // Kernel code (0x08)
+    entries[2].entry = data.ulong;      // Kernel data (0x10)
+    entries[3].entry = user_data.ulong; // User data (0x18 | 3 = 0x1B)
+    entries[4].entry = user_code.ulong; // User code (0x20 | 3 = 0x23)
+    entries[5].entry = 0; // TSS low
+    entries[6].entry = 0; // TSS high
 
-    gdt.limit = sizeof(g_entries[0]) * LONG_MODE_GDT_GATES - 1;
-    gdt.base = reinterpret_cast<uint64_t>(&g_entries);
+    gdt.limit = sizeof(entries[0]) * LONG_MODE_GDT_GATES - 1;
+    gdt.base = reinterpret_cast<uint64_t>(entries);
 
     gdt_reload(&gdt);
 }
 
-void tss_set_gate(paddr_t addr)
+static void tss_set_gate(gdt_entry *entries, uintptr_t address)
 {
     gdt_tss_entry tss;
-    tss.ulong[0] = g_entries[5].entry;
-    tss.ulong[1] = g_entries[6].entry;
+    tss.ulong[0] = 0;
+    tss.ulong[1] = 0;
 
-    //uint16_t limit    = sizeof(g_entries[0]) * LONG_MODE_GDT_GATES - 1;
-    uintptr_t address = ptr_from(addr);
+    uintptr_t limit = sizeof(tss_entry) - 1;
 
     tss.fields_lo.base_addr_lo = address & 0xffffff;
     tss.fields_lo.base_addr_md = (address >> 24) & 0xff;
     tss.fields_hi.base_addr_hi = address >> 32;
-    tss.fields_lo.limit_lo     = 0xffff;
-    tss.fields_lo.limit_hi     = 0xf;
+    tss.fields_lo.limit_lo     = limit & 0xffff;
+    tss.fields_lo.limit_hi     = (limit >> 16) & 0xf;
     tss.fields_lo.avl          = 0x0;
-    tss.fields_lo.dpl          = 0x3;
+    tss.fields_lo.dpl          = 0x0;
     tss.fields_lo.present      = 0x1;
     tss.fields_lo.zero         = 0x0;
     tss.fields_lo.type         = 0x9; // 0b1001 - see above
     tss.fields_hi.zero         = 0x0;
 
-    g_entries[5].entry = tss.ulong[0];
-    g_entries[6].entry = tss.ulong[1];
+    entries[5].entry = tss.ulong[0];
+    entries[6].entry = tss.ulong[1];
+}
+
+void tss_setup(uint32_t cpu, uint64_t kernel_stack)
+{
+    static_assert(sizeof(tss_entry) == 104, "sizeof(tss_entry) != 104");
+
+    auto *tss = &t_entries[cpu];
+    lib::memset(tss, 0, sizeof(tss_entry));
+
+    // interrupts taken in ring 3 switch to the same stack SYSCALL uses
+    tss->rsp[0]     = kernel_stack;
+    tss->iomap_base = sizeof(tss_entry);
+
+    tss_set_gate(g_entries[cpu], ptr_from(tss));
+    insn::ltr(TSS_SELECTOR);
+}
+
+void tss_set_stack(uint32_t cpu, uint64_t kernel_stack)
+{
+    t_entries[cpu].rsp[0] = kernel_stack;
 }
 
 void idt_setup()
@@ -264,22 +321,10 @@ void idt_setup()
     irq_remap();
     lib::log(lib::log_level::TRACE, "IRQ remapped");
 
-    idt_add_gate(i_entries, 32, &irq0);
-    idt_add_gate(i_entries, 33, &irq1);
-    idt_add_gate(i_entries, 34, &irq2);
-    idt_add_gate(i_entries, 35, &irq3);
-    idt_add_gate(i_entries, 36, &irq4);
-    idt_add_gate(i_entries, 37, &irq5);
-    idt_add_gate(i_entries, 38, &irq6);
-    idt_add_gate(i_entries, 39, &irq7);
-    idt_add_gate(i_entries, 40, &irq8);
-    idt_add_gate(i_entries, 41, &irq9);
-    idt_add_gate(i_entries, 42, &irq10);
-    idt_add_gate(i_entries, 43, &irq11);
-    idt_add_gate(i_entries, 44, &irq12);
-    idt_add_gate(i_entries, 45, &irq13);
-    idt_add_gate(i_entries, 46, &irq14);
-    idt_add_gate(i_entries, 47, &irq15);
+    for (uint16_t vector = IRQ_FIRST_VECTOR; vector < LONG_MODE_IDT_GATES; vector++) {
+        auto stub = &irq_stubs[(vector - IRQ_FIRST_VECTOR) * IRQ_STUB_SIZE];
+        idt_add_gate(i_entries, vector, reinterpret_cast<void (*)()>(stub));
+    }
     lib::log(lib::log_level::TRACE, "Set all IRQs");
 
     // Add syscall interrupt (0x80) - user accessible
@@ -289,6 +334,30 @@ void idt_setup()
     insn::sti();
 }
 
+void idt_load()
+{
+    idt_ptr idt_ptr;
+
+    idt_ptr.limit = (sizeof(idt_entry) * LONG_MODE_IDT_GATES) - 1;
+    idt_ptr.base = reinterpret_cast<uint64_t>(i_entries);
+    insn::lidt(reinterpret_cast<uintptr_t>(&idt_ptr));
+}
+
+void syscall_setup()
+{
+    insn::wrmsr(MSR_EFER, insn::rdmsr(MSR_EFER) | EFER_SCE);
+
+    // STAR[47:32] kernel CS (SS = CS + 8), STAR[63:48] base for the user selectors
+    uint64_t star = (static_cast<uint64_t>(USER_BASE_SELECTOR | 0x3) << 48)
+                  | (static_cast<uint64_t>(KERNEL_CODE_SELECTOR) << 32);
+
+    insn::wrmsr(MSR_STAR, star);
+    insn::wrmsr(MSR_LSTAR, reinterpret_cast<uintptr_t>(&syscall_entry));
+    insn::wrmsr(MSR_FMASK, SYSCALL_RFLAGS_MASK);
+
+    lib::log(lib::log_level::TRACE, "Set syscall/sysret entry point");
+}
+
 void idt_add_gate(idt_entry *entries, uint8_t gate, void (*function_ptr)())
 {
     uintptr_t function = reinterpret_cast<uintptr_t>(function_ptr);
@@ -382,4 +451,15 @@ void irq_remap()
 
     insn::outb(PIC1_DATA, 0);
     insn::outb(PIC2_DATA, 0);
+}
+
+void pic_disable()
+{
+    // the 8259s stay remapped to 0x20 - 0x2f so a stray interrupt raised
+    // while masking can't be mistaken for an exception
+    const int PIC1_DATA = 0x21;
+    const int PIC2_DATA = 0xA1;
+
+    insn::outb(PIC1_DATA, 0xff);
+    insn::outb(PIC2_DATA, 0xff);
 }
\ No newline at end of file
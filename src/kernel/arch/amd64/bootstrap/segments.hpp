@@ -3,8 +3,14 @@
 
 #include "libs/stdint.hpp"
 
-void gdt_setup();
+// every cpu has its own GDT and TSS, the IDT is shared
+void gdt_setup(uint32_t cpu);
+void tss_setup(uint32_t cpu, uint64_t kernel_stack);
+void tss_set_stack(uint32_t cpu, uint64_t kernel_stack);
 void idt_setup();
+void idt_load();
+void syscall_setup();
+void pic_disable();
 
 extern "C"
 {
@@ -41,25 +47,14 @@ extern "C"
     void rsB();
     void rsC();
 
-    void irq0();
-    void irq1();
-    void irq2();
-    void irq3();
-    void irq4();
-    void irq5();
-    void irq6();
-    void irq7();
-    void irq8();
-    void irq9();
-    void irq10();
-    void irq11();
-    void irq12();
-    void irq13();
-    void irq14();
-    void irq15();
-    
+    // stubs for vectors 0x20 - 0xff, see isr.S
+    extern const uint8_t irq_stubs[];
+
     // Syscall interrupt handler
     void syscall_int();
+
+    // SYSCALL instruction entry point (LSTAR)
+    void syscall_entry();
 }
 
 #endif // SEGMENTS_HPP
\ No newline at end of file
@@ -0,0 +1,247 @@
+#include "fpu.hpp"
+#include "instructions.hpp"
+#include "bootstrap/irq.hpp"
+
+#include "libs/logger.hpp"
+#include "libs/string.hpp"
+#include "memory/allocators.hpp"
+#include "task/task.hpp"
+
+constexpr uint64_t CR0_MP = 1ull << 1;  // monitor coprocessor (wait/fwait honor TS)
+constexpr uint64_t CR0_EM = 1ull << 2;  // x87 emulation, must be off
+constexpr uint64_t CR0_TS = 1ull << 3;  // task switched, #NM on next FPU instruction
+constexpr uint64_t CR0_NE = 1ull << 5;  // native x87 error reporting
+
+constexpr uint64_t CR4_OSFXSR     = 1ull << 9;
+constexpr uint64_t CR4_OSXMMEXCPT = 1ull << 10;
+constexpr uint64_t CR4_OSXSAVE    = 1ull << 18;
+
+constexpr uint32_t CPUID_1_EDX_FXSR    = 1u << 24;
+constexpr uint32_t CPUID_1_ECX_XSAVE   = 1u << 26;
+constexpr uint32_t CPUID_D1_EAX_XSAVEOPT = 1u << 0;
+
+// XCR0 components we are willing to context switch: x87, SSE, AVX and
+// the three AVX-512 components (opmask, ZMM_Hi256, Hi16_ZMM)
+constexpr uint64_t XCR0_SUPPORTED = 0xe7;
+
+constexpr size_t FXSAVE_AREA_SIZE = 512;
+constexpr size_t XSAVE_ALIGNMENT  = 64;
+
+constexpr uint32_t MXCSR_DEFAULT = 0x1f80;
+
+constexpr uint8_t VECTOR_DEVICE_NOT_AVAILABLE = 0x07;
+
+enum class save_mode
+{
+    FXSAVE,
+    XSAVE,
+    XSAVEOPT
+};
+
+struct fpu_context
+{
+    save_mode mode;
+    uint64_t  xcr0;
+    size_t    size;
+
+    // registers currently hold this task's state
+    task_t   *owner;
+    // task running on this cpu, its state is restored on the next #NM
+    task_t   *current;
+
+    // state right after fninit, used to seed new tasks
+    void     *init_state;
+};
+
+static fpu_context context_;
+
+static void save(void *area)
+{
+    auto lo = static_cast<uint32_t>(context_.xcr0);
+    auto hi = static_cast<uint32_t>(context_.xcr0 >> 32);
+
+    switch (context_.mode) {
+        case save_mode::XSAVEOPT:
+            asm volatile("xsaveopt64 (%0)" : : "r"(area), "a"(lo), "d"(hi) : "memory");
+            break;
+
+        case save_mode::XSAVE:
+            asm volatile("xsave64 (%0)" : : "r"(area), "a"(lo), "d"(hi) : "memory");
+            break;
+
+        case save_mode::FXSAVE:
+            asm volatile("fxsave64 (%0)" : : "r"(area) : "memory");
+            break;
+    }
+}
+
+static void restore(const void *area)
+{
+    auto lo = static_cast<uint32_t>(context_.xcr0);
+    auto hi = static_cast<uint32_t>(context_.xcr0 >> 32);
+
+    if (context_.mode == save_mode::FXSAVE) {
+        asm volatile("fxrstor64 (%0)" : : "r"(area) : "memory");
+    }
+    else {
+        asm volatile("xrstor64 (%0)" : : "r"(area), "a"(lo), "d"(hi) : "memory");
+    }
+}
+
+void fpu::setup()
+{
+    uint32_t eax, ebx, ecx, edx;
+    insn::cpuid(1, 0, eax, ebx, ecx, edx);
+
+    if ((edx & CPUID_1_EDX_FXSR) == 0) {
+        lib::log(lib::log_level::CRITICAL, "FPU: fxsave not supported");
+        return;
+    }
+
+    auto cr0 = insn::read_cr0();
+    cr0 &= ~(CR0_EM | CR0_TS);
+    cr0 |= CR0_MP | CR0_NE;
+    insn::write_cr0(cr0);
+
+    auto cr4 = insn::read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT;
+
+    context_.mode = save_mode::FXSAVE;
+    context_.xcr0 = 0;
+    context_.size = FXSAVE_AREA_SIZE;
+
+    if (ecx & CPUID_1_ECX_XSAVE) {
+        insn::write_cr4(cr4 | CR4_OSXSAVE);
+
+        // leaf 0xd, subleaf 0: eax:edx = supported XCR0 bits
+        insn::cpuid(0xd, 0, eax, ebx, ecx, edx);
+        context_.xcr0 = ((static_cast<uint64_t>(edx) << 32) | eax) & XCR0_SUPPORTED;
+        insn::xsetbv(0, context_.xcr0);
+
+        // ebx now reports the area size for the components enabled in XCR0
+        insn::cpuid(0xd, 0, eax, ebx, ecx, edx);
+        context_.size = ebx;
+
+        insn::cpuid(0xd, 1, eax, ebx, ecx, edx);
+        context_.mode = (eax & CPUID_D1_EAX_XSAVEOPT) ? save_mode::XSAVEOPT : save_mode::XSAVE;
+    }
+    else {
+        insn::write_cr4(cr4);
+    }
+
+    // capture a clean state to seed every new task with, XSAVE needs the
+    // header (bytes 512..575) zeroed before the first save
+    context_.init_state = placement_kalloc(context_.size, true);
+    lib::memset(context_.init_state, 0, context_.size);
+
+    asm volatile("fninit");
+    asm volatile("ldmxcsr %0" : : "m"(MXCSR_DEFAULT));
+    save(context_.init_state);
+
+    // nobody owns the registers yet, trap on first use
+    context_.owner = nullptr;
+    context_.current = nullptr;
+    insn::write_cr0(insn::read_cr0() | CR0_TS);
+
+    register_interrupt(VECTOR_DEVICE_NOT_AVAILABLE, [](const interrupt_t &interrupt, void *) {
+        fpu::on_device_not_available(interrupt);
+    }, nullptr);
+
+    lib::log(lib::log_level::INFO, "FPU: lazy state switching enabled");
+}
+
+void fpu::setup_ap()
+{
+    auto cr0 = insn::read_cr0();
+    cr0 &= ~(CR0_EM | CR0_TS);
+    cr0 |= CR0_MP | CR0_NE;
+    insn::write_cr0(cr0);
+
+    auto cr4 = insn::read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT;
+
+    if (context_.mode != save_mode::FXSAVE) {
+        insn::write_cr4(cr4 | CR4_OSXSAVE);
+        insn::xsetbv(0, context_.xcr0);
+    }
+    else {
+        insn::write_cr4(cr4);
+    }
+
+    asm volatile("fninit");
+    asm volatile("ldmxcsr %0" : : "m"(MXCSR_DEFAULT));
+}
+
+size_t fpu::state_size()
+{
+    return context_.size;
+}
+
+void *fpu::create_state()
+{
+    if (context_.init_state == nullptr) {
+        return nullptr;
+    }
+
+    void *state = memory::kmalloc_aligned(XSAVE_ALIGNMENT, context_.size);
+    if (state == nullptr) {
+        lib::log(lib::log_level::CRITICAL, "FPU: unable to allocate state area");
+        return nullptr;
+    }
+
+    lib::memcpy(state, context_.init_state, context_.size);
+    return state;
+}
+
+void fpu::destroy_state(void *state)
+{
+    memory::kfree_aligned(state);
+}
+
+void fpu::switch_to(task_t *next)
+{
+    context_.current = next;
+
+    if (next != nullptr && next == context_.owner) {
+        // registers still hold next's state, no trap needed
+        insn::clts();
+        return;
+    }
+
+    insn::write_cr0(insn::read_cr0() | CR0_TS);
+}
+
+void fpu::release(task_t *task)
+{
+    if (context_.owner == task) {
+        context_.owner = nullptr;
+    }
+
+    if (context_.current == task) {
+        context_.current = nullptr;
+    }
+}
+
+void fpu::on_device_not_available(const interrupt_t &)
+{
+    insn::clts();
+
+    auto *owner = context_.owner;
+    auto *next  = context_.current;
+
+    if (owner == next && owner != nullptr) {
+        return;
+    }
+
+    if (owner != nullptr && owner->fpu_state != nullptr) {
+        save(owner->fpu_state);
+    }
+
+    if (next != nullptr && next->fpu_state != nullptr) {
+        restore(next->fpu_state);
+    }
+    else {
+        // kernel context without a task: hand out a clean state
+        restore(context_.init_state);
+    }
+
+    context_.owner = next;
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef FPU_HPP
+#define FPU_HPP
+
+#include "libs/stdint.hpp"
+#include "arch/amd64/registers.hpp"
+
+struct task_t;
+
+/*
+ * x87/SSE/AVX register state
+ *
+ * Every task owns an XSAVE area (FXSAVE on CPUs without XSAVE) sized from
+ * CPUID leaf 0xd for the components enabled in XCR0. The state is switched
+ * lazily: switch_to() only sets CR0.TS when the incoming task doesn't own
+ * the registers, the first FPU/SSE/AVX instruction then raises #NM and the
+ * handler saves the previous owner and restores the new one.
+ *
+ *    task A runs SSE      switch to B        B runs integer code    B runs SSE
+ *   +---------------+   +--------------+   +------------------+   +-------------+
+ *   | owner = A     |-->| TS = 1       |-->| nothing saved    |-->| #NM: save A |
+ *   +---------------+   +--------------+   +------------------+   | restore B   |
+ *                                                                 +-------------+
+ *
+ * The save uses XSAVEOPT when available, which skips components that are
+ * still in their init state or weren't modified since the last XRSTOR of
+ * that area, so a task that only touched SSE doesn't pay for the AVX upper
+ * halves.
+ */
+namespace fpu
+{
+    void setup();
+
+    // enables the same state components on an application processor.
+    // Ownership is only tracked for the BSP, nothing is scheduled on the
+    // APs yet, so CR0.TS stays clear there.
+    void setup_ap();
+
+    size_t state_size();
+
+    void *create_state();
+    void destroy_state(void *state);
+
+    void switch_to(task_t *next);
+    void release(task_t *task);
+
+    void on_device_not_available(const interrupt_t &interrupt);
+}
+
+#endif // FPU_HPP
\ No newline at end of file
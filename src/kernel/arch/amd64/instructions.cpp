@@ -8,6 +8,17 @@ void insn::cli() {
     __asm__ __volatile__("cli");
 }
 
+// disables interrupts and returns the previous rflags
+uint64_t insn::irq_save() {
+    uint64_t flags;
+    __asm__ __volatile__("pushfq; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+void insn::irq_restore(uint64_t flags) {
+    __asm__ __volatile__("push %0; popfq" : : "r"(flags) : "memory", "cc");
+}
+
 void insn::hlt() {
     __asm__ __volatile__("hlt");
 }
@@ -103,7 +114,114 @@ void insn::lidt(uint64_t idt)
                  : "r"(idt));
 }
 
+void insn::ltr(uint16_t selector)
+{
+    asm volatile("ltr %0"
+                 :
+                 : "r"(selector));
+}
+
 void insn::io_wait()
 {
     insn::outb(0x80, 0);
+}
+
+void insn::cpuid(uint32_t leaf, uint32_t subleaf,
+                 uint32_t &eax, uint32_t &ebx, uint32_t &ecx, uint32_t &edx)
+{
+    asm volatile("cpuid"
+                 : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                 : "a"(leaf), "c"(subleaf));
+}
+
+uint64_t insn::rdmsr(uint32_t msr)
+{
+    uint32_t lo, hi;
+    asm volatile("rdmsr"
+                 : "=a"(lo), "=d"(hi)
+                 : "c"(msr));
+
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+void insn::wrmsr(uint32_t msr, uint64_t value)
+{
+    asm volatile("wrmsr"
+                 :
+                 : "c"(msr), "a"(static_cast<uint32_t>(value)), "d"(static_cast<uint32_t>(value >> 32)));
+}
+
+uint64_t insn::read_cr0()
+{
+    uint64_t cr0;
+    asm volatile("mov %%cr0, %0"
+                 : "=r"(cr0));
+
+    return cr0;
+}
+
+void insn::write_cr0(uint64_t value)
+{
+    asm volatile("mov %0, %%cr0"
+                 :
+                 : "r"(value)
+                 : "memory");
+}
+
+uint64_t insn::read_cr4()
+{
+    uint64_t cr4;
+    asm volatile("mov %%cr4, %0"
+                 : "=r"(cr4));
+
+    return cr4;
+}
+
+void insn::write_cr4(uint64_t value)
+{
+    asm volatile("mov %0, %%cr4"
+                 :
+                 : "r"(value)
+                 : "memory");
+}
+
+void insn::clts()
+{
+    asm volatile("clts");
+}
+
+uint64_t insn::rdtsc()
+{
+    uint32_t lo, hi;
+    asm volatile("rdtsc"
+                 : "=a"(lo), "=d"(hi));
+
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+uint64_t insn::rdpmc(uint32_t counter)
+{
+    uint32_t lo, hi;
+    asm volatile("rdpmc"
+                 : "=a"(lo), "=d"(hi)
+                 : "c"(counter));
+
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+uint64_t insn::xgetbv(uint32_t xcr)
+{
+    uint32_t lo, hi;
+    asm volatile("xgetbv"
+                 : "=a"(lo), "=d"(hi)
+                 : "c"(xcr));
+
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+void insn::xsetbv(uint32_t xcr, uint64_t value)
+{
+    asm volatile("xsetbv"
+                 :
+                 : "c"(xcr), "a"(static_cast<uint32_t>(value)), "d"(static_cast<uint32_t>(value >> 32)));
 }
\ No newline at end of file
@@ -7,6 +7,8 @@ namespace insn
 {
     void sti();
     void cli();
+    uint64_t irq_save();
+    void irq_restore(uint64_t flags);
     void hlt();
     void pause();
     void breakpoint();
@@ -19,12 +21,31 @@ namespace insn
     uint32_t inl(uint16_t port);
 
     void lidt(uint64_t idt);
+    void ltr(uint16_t selector);
 
     paddr_t get_current_page();
     void set_page_directory(paddr_t page_dir);
 
     void tlb_flush(paddr_t addr);
     void io_wait();
+
+    void cpuid(uint32_t leaf, uint32_t subleaf,
+               uint32_t &eax, uint32_t &ebx, uint32_t &ecx, uint32_t &edx);
+
+    uint64_t rdmsr(uint32_t msr);
+    void wrmsr(uint32_t msr, uint64_t value);
+
+    uint64_t read_cr0();
+    void write_cr0(uint64_t value);
+    uint64_t read_cr4();
+    void write_cr4(uint64_t value);
+    void clts();
+
+    uint64_t rdtsc();
+    uint64_t rdpmc(uint32_t counter);
+
+    uint64_t xgetbv(uint32_t xcr);
+    void xsetbv(uint32_t xcr, uint64_t value);
 }
 
 #endif // INSTRUCTIONS_HPP
\ No newline at end of file
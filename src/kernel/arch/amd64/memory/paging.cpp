@@ -4,6 +4,7 @@
 #include "libs/logger.hpp"
 #include "libs/string.hpp"
 #include "memory/allocators.hpp"
+#include "memory/vdso_page.hpp"
 #include "arch/amd64/instructions.hpp"
 
 #define PTE(addr)       ((ptr_from(addr) >> 12) & 0x1ff)
@@ -24,9 +25,15 @@ enum PERMISSION_FLAGS {
     PRESENT = 0x01,
     WRITABLE = 0x02,
     USER = 0x04,
-    USER_RW = 0x07
+    USER_RW = 0x07,
+    WRITE_THROUGH = 0x08,
+    CACHE_DISABLE = 0x10
 };
 
+constexpr uint32_t MSR_PAT             = 0x277;
+constexpr uint64_t PAT_ENTRY_PWT       = 8;    // bit offset of PAT entry 1
+constexpr uint64_t PAT_WRITE_COMBINING = 0x01;
+
 /*
  *   ADDRESS    CONTENT     page_dir = 0x1000
  *   0x1000     0x8003
@@ -191,17 +198,63 @@ int paging::map(vaddr_t vaddr, paddr_t paddr, uint8_t flags)
 }
 
 vaddr_t paging::mapio(uintptr_t addr, uint8_t flags)
+{
+    return mapio(addr, 1, flags);
+}
+
+// device memory is handed out from the window above the kernel mapping,
+// contiguous for the whole range and never reused
+static uintptr_t next_io = PCI_VIRTUAL_ADDRESS;
+
+vaddr_t paging::map_window(uintptr_t addr, size_t size, uint64_t cache_flags)
+{
+    uintptr_t first = ALIGN_DOWN(addr);
+    uintptr_t last  = ALIGN_UP(addr + size);
+    uintptr_t vaddr = next_io;
+
+    size_t left = PCI_VIRTUAL_SIZE - (next_io - PCI_VIRTUAL_ADDRESS);
+    if (last < first || last - first > left) {
+        lib::log(lib::log_level::ERROR, "Paging: IO window full, can't map {} bytes at {:p}",
+                 size, ptr_to<vaddr_t>(addr));
+        return nullptr;
+    }
+
+    for (uintptr_t paddr = first; paddr < last; paddr += FRAME_SIZE) {
+        pte_t *page = get_page(insn::get_current_page(), ptr_to<vaddr_t>(next_io), 0x0, true);
+        page->pages[PTE(next_io)] = paddr | PERMISSION_FLAGS::PRESENT | PERMISSION_FLAGS::WRITABLE | cache_flags;
+
+        insn::tlb_flush(ptr_to<paddr_t>(next_io));
+        next_io += FRAME_SIZE;
+    }
+
+    return ptr_to<vaddr_t>(vaddr + (addr - first));
+}
+
+vaddr_t paging::mapio(uintptr_t addr, size_t size, uint8_t flags)
 {
     (void)flags;
 
-    uintptr_t offset = addr & ~0xfff0'0000;
-    vaddr_t vaddr = ptr_to<vaddr_t>(PCI_VIRTUAL_ADDRESS + offset);
-    auto pte = PTE(PCI_VIRTUAL_ADDRESS | offset);
+    // registers must never be cached
+    return map_window(addr, size, PERMISSION_FLAGS::WRITE_THROUGH | PERMISSION_FLAGS::CACHE_DISABLE);
+}
+
+vaddr_t paging::map_framebuffer(uintptr_t addr, size_t size)
+{
+    // PAT entry 1 (PWT alone) is write-through after reset, nothing else
+    // maps with it, so turn it into write-combining for linear framebuffers
+    auto pat = insn::rdmsr(MSR_PAT);
+    if (((pat >> PAT_ENTRY_PWT) & 0xff) != PAT_WRITE_COMBINING) {
+        pat &= ~(0xffull << PAT_ENTRY_PWT);
+        pat |= PAT_WRITE_COMBINING << PAT_ENTRY_PWT;
+        insn::wrmsr(MSR_PAT, pat);
+    }
 
-    pte_t *page = get_page(insn::get_current_page(), vaddr, 0x0, true);
-    page->pages[pte] = addr + 0x3;
+    return map_window(addr, size, PERMISSION_FLAGS::WRITE_THROUGH);
+}
 
-    return vaddr;
+vaddr_t paging::map_memory(uintptr_t addr, size_t size)
+{
+    return map_window(addr, size, 0);
 }
 
 void paging::unmapio(vaddr_t vaddr)
@@ -215,7 +268,7 @@ paddr_t paging::create_page_directory()
     auto pml4_index = PML4(KVIRTUAL_ADDRESS);
     paddr_t page_dir;
     pml4_t *page_dir_virt = static_cast<pml4_t*>(placement_kalloc(sizeof(pml4_t), &page_dir, true));
-    lib::memset(page_dir_virt, 0x0, sizeof(pml4_t));
+    lib::memset(page_dir_virt, 0, sizeof(pml4_t));
 
     pml4_t *pml4_table = ptr_to<pml4_t*>(ADDRESS(insn::get_current_page()));
     if (!PRESENT(pml4_table->dirs[pml4_index])) {
@@ -242,7 +295,14 @@ paddr_t paging::create_user_page_directory()
         // Failed to create user page directory
         return nullptr;
     }
-    
+
+    // every process gets a read-only view of the vDSO time page
+    if (map(user_page_dir, ptr_to<vaddr_t>(vdso::USER_VDSO_ADDR), memory::vdso_physical(),
+            PERMISSION_FLAGS::PRESENT | PERMISSION_FLAGS::USER) != 0) {
+        lib::log(lib::log_level::CRITICAL, "Unable to map the vDSO page");
+        return nullptr;
+    }
+
     return user_page_dir;
 }
 
@@ -262,7 +322,7 @@ bool paging::setup_user_memory_layout(paddr_t page_dir)
         }
         
         // Clear the stack memory
-        lib::memset(stack_mem, 0, 0x1000);
+        lib::zero_page(stack_mem);
         
         // Map stack page with user permissions
         uint64_t virtual_addr = stack_bottom + (i * 0x1000);
@@ -10,6 +10,7 @@ class paging
 
     private:
     pte_t *get_page(paddr_t page_dir, vaddr_t vaddr, uint8_t flags, bool make);
+    vaddr_t map_window(uintptr_t addr, size_t size, uint64_t cache_flags);
 
     public:
     paging() = default;
@@ -22,8 +23,15 @@ class paging
     void unmap(vaddr_t vaddr);
 
     vaddr_t mapio(uintptr_t addr, uint8_t flags);
+    vaddr_t mapio(uintptr_t addr, size_t size, uint8_t flags);
     void unmapio(vaddr_t vaddr);
 
+    // write-combining mapping for linear framebuffers
+    vaddr_t map_framebuffer(uintptr_t addr, size_t size);
+
+    // write-back mapping for RAM the firmware left data in (ACPI tables)
+    vaddr_t map_memory(uintptr_t addr, size_t size);
+
     paddr_t create_page_directory();
     
     // User space
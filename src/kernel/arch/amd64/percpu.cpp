@@ -0,0 +1,70 @@
+#include "percpu.hpp"
+#include "instructions.hpp"
+
+#include "config.hpp"
+#include "memory/allocators.hpp"
+#include "bootstrap/irq_stats.hpp"
+#include "bootstrap/segments.hpp"
+
+static_assert(__builtin_offsetof(percpu_t, self) == PERCPU_SELF, "percpu_t::self offset");
+static_assert(__builtin_offsetof(percpu_t, kernel_stack) == PERCPU_KERNEL_STACK, "percpu_t::kernel_stack offset");
+static_assert(__builtin_offsetof(percpu_t, user_stack) == PERCPU_USER_STACK, "percpu_t::user_stack offset");
+
+static percpu_t cpus_[MAX_CPUS];
+
+// GS base is zero until the BSP runs setup(), %gs:0 would fault
+static bool ready_ = false;
+
+void percpu::setup(uint32_t id, uint32_t apic_id)
+{
+    percpu_t *cpu = &cpus_[id];
+
+    cpu->self    = cpu;
+    cpu->id      = id;
+    cpu->apic_id = apic_id;
+
+    // stacks grow down, keep the top 16-byte aligned for the ABI
+    auto stack = ptr_from(placement_kalloc(KSTACK_SIZE, true));
+    cpu->kernel_stack = (stack + KSTACK_SIZE) & ~0xfull;
+    cpu->user_stack   = 0;
+
+    cpu->irq_stats    = irqstats::create();
+
+    // segment loads clear the GS base, this must run after gdt_setup()
+    insn::wrmsr(X86_MSR_GS_BASE, ptr_from(cpu));
+    insn::wrmsr(X86_MSR_KERNEL_GS_BASE, 0);
+
+    ready_ = true;
+}
+
+percpu_t *percpu::get()
+{
+    if (!ready_) {
+        return &cpus_[0];
+    }
+
+    percpu_t *cpu;
+    asm volatile("movq %%gs:%c1, %0"
+                 : "=r"(cpu)
+                 : "i"(PERCPU_SELF));
+
+    return cpu;
+}
+
+percpu_t *percpu::get(uint32_t id)
+{
+    return (id < MAX_CPUS) ? &cpus_[id] : nullptr;
+}
+
+uint32_t percpu::id()
+{
+    return get()->id;
+}
+
+void percpu::set_kernel_stack(uint64_t top)
+{
+    auto *cpu = get();
+
+    cpu->kernel_stack = top;
+    tss_set_stack(cpu->id, top);
+}
\ No newline at end of file
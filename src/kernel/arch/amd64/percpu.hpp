@@ -0,0 +1,68 @@
+#ifndef PERCPU_HPP
+#define PERCPU_HPP
+
+/*
+ * per-cpu data
+ *
+ * Each cpu has a percpu_t block and the kernel GS base points to it, so
+ * %gs:offset reaches the current cpu's data in a single instruction. The
+ * offsets below are used by the assembly entry points and must match the
+ * struct layout (checked by static_assert in percpu.cpp).
+ *
+ *   user mode:   GS_BASE = user value,  KERNEL_GS_BASE = &percpu_t
+ *   kernel mode: GS_BASE = &percpu_t,   KERNEL_GS_BASE = user value
+ *
+ * swapgs exchanges both on every kernel entry/exit from ring 3.
+ */
+#define PERCPU_SELF             0x00
+#define PERCPU_KERNEL_STACK     0x08
+#define PERCPU_USER_STACK       0x10
+
+#define X86_MSR_GS_BASE         0xc0000101
+#define X86_MSR_KERNEL_GS_BASE  0xc0000102
+
+#ifndef __ASSEMBLER__
+    #include "libs/stdint.hpp"
+
+    namespace irqstats
+    {
+        struct cpu_stats;
+    }
+
+    struct percpu_t
+    {
+        percpu_t *self;
+        uint64_t  kernel_stack; // top of the running task's kernel stack
+        uint64_t  user_stack;   // user rsp stashed by syscall entry
+        uint32_t  id;           // logical cpu number (0 is the BSP)
+        uint32_t  apic_id;
+
+        irqstats::cpu_stats *irq_stats;
+    };
+
+    namespace percpu
+    {
+        void setup(uint32_t id, uint32_t apic_id);
+
+        percpu_t *get();
+        percpu_t *get(uint32_t id);
+
+        uint32_t id();
+
+        // stack SYSCALL and ring 3 interrupts switch to on this cpu, each
+        // task gets its own so a syscall can block
+        void set_kernel_stack(uint64_t top);
+    }
+#else
+    # Interrupted user mode runs with the user GS base, swap to the per-cpu
+    # block for the handler and back before returning. cs_offset is where
+    # the CS pushed by the CPU sits relative to %rsp.
+    .macro swapgs_if_user cs_offset
+        testb $3, \cs_offset(%rsp)
+        jz 1f
+        swapgs
+    1:
+    .endm
+#endif // __ASSEMBLER__
+
+#endif // PERCPU_HPP
\ No newline at end of file
@@ -0,0 +1,385 @@
+#include "pmu.hpp"
+#include "instructions.hpp"
+#include "percpu.hpp"
+#include "apic/lapic.hpp"
+#include "bootstrap/irq.hpp"
+
+#include "config.hpp"
+#include "arch/iprotected_mode.hpp"
+#include "libs/logger.hpp"
+#include "libs/profiler.hpp"
+#include "task/task.hpp"
+
+constexpr uint32_t MSR_PMC0             = 0xc1;
+constexpr uint32_t MSR_PERFEVTSEL0      = 0x186;
+constexpr uint32_t MSR_FIXED_CTR0       = 0x309;
+constexpr uint32_t MSR_FIXED_CTR_CTRL   = 0x38d;
+constexpr uint32_t MSR_GLOBAL_STATUS    = 0x38e;
+constexpr uint32_t MSR_GLOBAL_CTRL      = 0x38f;
+constexpr uint32_t MSR_GLOBAL_OVF_CTRL  = 0x390;
+
+constexpr uint64_t EVTSEL_USR = 1ull << 16;
+constexpr uint64_t EVTSEL_OS  = 1ull << 17;
+constexpr uint64_t EVTSEL_INT = 1ull << 20;
+constexpr uint64_t EVTSEL_EN  = 1ull << 22;
+
+// fixed counter control, 4 bits per counter: ring 0, ring 3
+constexpr uint64_t FIXED_OS_USR = 0x3;
+
+// RDPMC selects the fixed counters with bit 30
+constexpr uint32_t RDPMC_FIXED = 1u << 30;
+
+// CPUID.0AH:EBX, a set bit means the event is NOT available
+constexpr uint32_t UNAVAILABLE_CYCLES       = 1u << 0;
+constexpr uint32_t UNAVAILABLE_INSTRUCTIONS = 1u << 1;
+constexpr uint32_t UNAVAILABLE_LLC_MISSES   = 1u << 4;
+
+constexpr uint8_t FIXED_INSTRUCTIONS = 0;
+constexpr uint8_t FIXED_CYCLES       = 1;
+
+constexpr uint8_t NO_COUNTER = 0xff;
+
+static_assert(sizeof(task_t::pmu_counts) / sizeof(uint64_t) == pmu::EVENTS,
+              "task_t::pmu_counts must hold every pmu event");
+
+struct event_info
+{
+    const char *name;
+    uint8_t     select;
+    uint8_t     umask;
+    uint32_t    unavailable;
+};
+
+static constexpr event_info EVENT_INFO[pmu::EVENTS] = {
+    { "cycles",       0x3c, 0x00, UNAVAILABLE_CYCLES },
+    { "instructions", 0xc0, 0x00, UNAVAILABLE_INSTRUCTIONS },
+    { "cache-misses", 0x2e, 0x41, UNAVAILABLE_LLC_MISSES },
+    // DTLB_LOAD_MISSES.MISS_CAUSES_A_WALK, not architectural: the encoding
+    // is the one shared by Nehalem through Skylake
+    { "dtlb-misses",  0x08, 0x01, 0 },
+};
+
+struct counter
+{
+    bool    fixed;
+    uint8_t index;  // NO_COUNTER when the event isn't counted
+};
+
+struct pmu_context
+{
+    uint8_t  version;
+    uint8_t  gp_count;
+    uint8_t  fixed_count;
+    uint64_t gp_mask;
+    uint64_t fixed_mask;
+
+    counter  counters[pmu::EVENTS];
+
+    // general purpose counter left over for sampling
+    uint8_t  sample_index;
+    uint8_t  sample_vector;
+    uint32_t sample_period;
+    bool     sampling;
+
+    // counter values at the last switch_to() of each cpu
+    uint64_t last[MAX_CPUS][pmu::EVENTS];
+};
+
+static pmu_context context_;
+
+static uint64_t mask(uint8_t width)
+{
+    return (width >= 64) ? ~0ull : (1ull << width) - 1;
+}
+
+static uint64_t evtsel(pmu::event e)
+{
+    const auto &info = EVENT_INFO[e];
+    return info.select | (static_cast<uint64_t>(info.umask) << 8) | EVTSEL_USR | EVTSEL_OS | EVTSEL_EN;
+}
+
+static uint64_t enabled_counters()
+{
+    uint64_t global = 0;
+
+    for (const auto &c : context_.counters) {
+        if (c.index == NO_COUNTER) {
+            continue;
+        }
+        global |= c.fixed ? (1ull << (32 + c.index)) : (1ull << c.index);
+    }
+
+    if (context_.sampling) {
+        global |= 1ull << context_.sample_index;
+    }
+
+    return global;
+}
+
+static void rearm_sample_counter()
+{
+    insn::wrmsr(MSR_PMC0 + context_.sample_index, -static_cast<uint64_t>(context_.sample_period));
+}
+
+static void on_overflow(const interrupt_t &interrupt)
+{
+    if (!context_.sampling) {
+        return;
+    }
+
+    lib::profiler::record(interrupt, lib::profiler::source::PMU);
+    rearm_sample_counter();
+
+    if (context_.version >= 2) {
+        insn::wrmsr(MSR_GLOBAL_OVF_CTRL, insn::rdmsr(MSR_GLOBAL_STATUS));
+    }
+
+    lapic::perf_interrupt(context_.sample_vector);
+}
+
+// the counters are per cpu, every cpu runs this with the same assignment
+static void program()
+{
+    uint64_t fixed_ctrl = 0;
+
+    for (uint8_t e = 0; e < pmu::EVENTS; e++) {
+        const auto &c = context_.counters[e];
+        if (c.index == NO_COUNTER) {
+            continue;
+        }
+
+        if (c.fixed) {
+            fixed_ctrl |= FIXED_OS_USR << (c.index * 4);
+        }
+        else {
+            insn::wrmsr(MSR_PMC0 + c.index, 0);
+            insn::wrmsr(MSR_PERFEVTSEL0 + c.index, evtsel(static_cast<pmu::event>(e)));
+        }
+    }
+
+    if (context_.fixed_count > 0) {
+        insn::wrmsr(MSR_FIXED_CTR_CTRL, fixed_ctrl);
+    }
+
+    if (context_.version >= 2) {
+        insn::wrmsr(MSR_GLOBAL_CTRL, enabled_counters());
+    }
+
+    for (uint8_t e = 0; e < pmu::EVENTS; e++) {
+        context_.last[percpu::id()][e] = pmu::read(static_cast<pmu::event>(e));
+    }
+}
+
+void pmu::setup()
+{
+    uint32_t eax, ebx, ecx, edx;
+    insn::cpuid(0, 0, eax, ebx, ecx, edx);
+    if (eax < 0xa) {
+        lib::log(lib::log_level::INFO, "PMU: no architectural performance monitoring");
+        return;
+    }
+
+    insn::cpuid(0xa, 0, eax, ebx, ecx, edx);
+    context_.version = static_cast<uint8_t>(eax & 0xff);
+    if (context_.version == 0) {
+        lib::log(lib::log_level::INFO, "PMU: no architectural performance monitoring");
+        return;
+    }
+
+    context_.gp_count = static_cast<uint8_t>((eax >> 8) & 0xff);
+    context_.gp_mask  = mask(static_cast<uint8_t>((eax >> 16) & 0xff));
+
+    // bits past the EBX vector length are unavailable events too
+    auto vector_length = (eax >> 24) & 0xff;
+    auto unavailable = ebx | ((vector_length < 32) ? ~0u << vector_length : 0);
+
+    if (context_.version >= 2) {
+        context_.fixed_count = static_cast<uint8_t>(edx & 0x1f);
+        context_.fixed_mask  = mask(static_cast<uint8_t>((edx >> 5) & 0xff));
+    }
+
+    uint8_t next_gp = 0;
+
+    for (uint8_t e = 0; e < EVENTS; e++) {
+        auto &c = context_.counters[e];
+        c.index = NO_COUNTER;
+
+        if (unavailable & EVENT_INFO[e].unavailable) {
+            continue;
+        }
+
+        uint8_t fixed = (e == INSTRUCTIONS) ? FIXED_INSTRUCTIONS :
+                        (e == CYCLES)       ? FIXED_CYCLES : NO_COUNTER;
+
+        if (fixed != NO_COUNTER && fixed < context_.fixed_count) {
+            c.fixed = true;
+            c.index = fixed;
+            continue;
+        }
+
+        if (next_gp < context_.gp_count) {
+            c.fixed = false;
+            c.index = next_gp++;
+        }
+    }
+
+    context_.sample_index = (next_gp < context_.gp_count) ? next_gp : NO_COUNTER;
+
+    program();
+
+    lib::log(lib::log_level::INFO, "PMU: version {}, {} general purpose and {} fixed counters",
+             context_.version, context_.gp_count, context_.fixed_count);
+}
+
+void pmu::setup_ap()
+{
+    if (available()) {
+        program();
+    }
+}
+
+bool pmu::available()
+{
+    return context_.version > 0;
+}
+
+bool pmu::has_event(event e)
+{
+    return e < EVENTS && context_.counters[e].index != NO_COUNTER;
+}
+
+const char *pmu::event_name(event e)
+{
+    return (e < EVENTS) ? EVENT_INFO[e].name : "unknown";
+}
+
+uint64_t pmu::read(event e)
+{
+    if (!has_event(e)) {
+        return 0;
+    }
+
+    const auto &c = context_.counters[e];
+    if (c.fixed) {
+        return insn::rdpmc(RDPMC_FIXED | c.index) & context_.fixed_mask;
+    }
+
+    return insn::rdpmc(c.index) & context_.gp_mask;
+}
+
+void pmu::switch_to(task_t *prev, task_t *)
+{
+    if (!available()) {
+        return;
+    }
+
+    auto *last = context_.last[percpu::id()];
+
+    for (uint8_t e = 0; e < EVENTS; e++) {
+        if (!has_event(static_cast<event>(e))) {
+            continue;
+        }
+
+        auto now = read(static_cast<event>(e));
+        auto width = context_.counters[e].fixed ? context_.fixed_mask : context_.gp_mask;
+
+        if (prev != nullptr) {
+            prev->pmu_counts[e] += (now - last[e]) & width;
+        }
+        last[e] = now;
+    }
+}
+
+uint64_t pmu::task_count(const task_t *task, event e)
+{
+    return (task != nullptr && e < EVENTS) ? task->pmu_counts[e] : 0;
+}
+
+void pmu::print(iprotected_mode *video)
+{
+    if (!available()) {
+        video->prints("No performance counters\n");
+        return;
+    }
+
+    video->prints("  pid       cycles instructions cache-misses  dtlb-misses\n");
+
+    auto flags = insn::irq_save();
+
+    auto *idle = get_task_manager().idle_task();
+    auto *task = idle;
+    do {
+        video->format("{:5} {:12} {:12} {:12} {:12}\n", task->pid,
+                      task_count(task, CYCLES),
+                      task_count(task, INSTRUCTIONS),
+                      task_count(task, CACHE_MISSES),
+                      task_count(task, DTLB_MISSES));
+        task = task->next;
+    } while (task != nullptr && task != idle);
+
+    insn::irq_restore(flags);
+}
+
+bool pmu::start_sampling(event e, uint32_t period)
+{
+    // overflows are delivered through the local APIC's LVT PMC entry
+    if (!available() || !lapic::enabled() || e >= EVENTS || context_.sample_index == NO_COUNTER ||
+        period == 0 || period >= (1u << 31) || context_.sampling) {
+        return false;
+    }
+
+    if (context_.sample_vector == 0) {
+        context_.sample_vector = allocate_vector();
+        if (context_.sample_vector == 0) {
+            lib::log(lib::log_level::ERROR, "PMU: no free vector for counter overflows");
+            return false;
+        }
+
+        register_interrupt(context_.sample_vector, [](const interrupt_t &interrupt, void *) {
+            on_overflow(interrupt);
+        }, nullptr);
+    }
+
+    auto flags = insn::irq_save();
+
+    context_.sample_period = period;
+    context_.sampling = true;
+
+    auto index = context_.sample_index;
+    insn::wrmsr(MSR_PERFEVTSEL0 + index, 0);
+    rearm_sample_counter();
+    lapic::perf_interrupt(context_.sample_vector);
+    insn::wrmsr(MSR_PERFEVTSEL0 + index, evtsel(e) | EVTSEL_INT);
+
+    if (context_.version >= 2) {
+        insn::wrmsr(MSR_GLOBAL_CTRL, enabled_counters());
+    }
+
+    insn::irq_restore(flags);
+    return true;
+}
+
+void pmu::stop_sampling()
+{
+    if (!context_.sampling) {
+        return;
+    }
+
+    auto flags = insn::irq_save();
+
+    insn::wrmsr(MSR_PERFEVTSEL0 + context_.sample_index, 0);
+    lapic::perf_mask();
+    context_.sampling = false;
+
+    if (context_.version >= 2) {
+        insn::wrmsr(MSR_GLOBAL_OVF_CTRL, insn::rdmsr(MSR_GLOBAL_STATUS));
+        insn::wrmsr(MSR_GLOBAL_CTRL, enabled_counters());
+    }
+
+    insn::irq_restore(flags);
+}
+
+bool pmu::sampling()
+{
+    return context_.sampling;
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#ifndef PMU_HPP
+#define PMU_HPP
+
+#include "libs/stdint.hpp"
+
+struct task_t;
+class iprotected_mode;
+
+/*
+ * Architectural performance monitoring (CPUID leaf 0xa)
+ *
+ * Four events are counted all the time, kernel and user mode included:
+ *
+ *     event           counter
+ *     CYCLES          fixed counter 1 (core cycles, unhalted)
+ *     INSTRUCTIONS    fixed counter 0 (instructions retired)
+ *     CACHE_MISSES    general purpose, last level cache misses
+ *     DTLB_MISSES     general purpose, dTLB load misses causing a walk
+ *
+ * switch_to() charges what the counters moved since the last switch to the
+ * task leaving the cpu (task_t::pmu_counts), so every task carries its own
+ * totals. The counters are read with RDPMC and never reset, deltas are
+ * taken modulo the counter width.
+ *
+ * start_sampling() programs one more general purpose counter to overflow
+ * every `period` events and hands each overflow interrupt (LVT PMC) to
+ * lib::profiler as a PMU sample, so a profile can be weighted by cycles or
+ * cache misses instead of wall clock ticks.
+ *
+ * CPUs without version 1 of the architectural PMU (AMD, QEMU's TCG) leave
+ * the driver unavailable and every count at zero.
+ */
+namespace pmu
+{
+    enum event : uint8_t
+    {
+        CYCLES,
+        INSTRUCTIONS,
+        CACHE_MISSES,
+        DTLB_MISSES,
+        EVENTS
+    };
+
+    void setup();
+
+    // programs the counters setup() picked on an application processor
+    void setup_ap();
+
+    bool available();
+    bool has_event(event e);
+    const char *event_name(event e);
+
+    // raw counter value on the current cpu
+    uint64_t read(event e);
+
+    void switch_to(task_t *prev, task_t *next);
+    uint64_t task_count(const task_t *task, event e);
+
+    // one line of counts per task on the run list
+    void print(iprotected_mode *video);
+
+    // period must be below 2^31, the counter is loaded with -period
+    bool start_sampling(event e, uint32_t period);
+    void stop_sampling();
+    bool sampling();
+}
+
+#endif // PMU_HPP
\ No newline at end of file
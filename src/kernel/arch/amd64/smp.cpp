@@ -0,0 +1,197 @@
+#include "smp.hpp"
+#include "fpu.hpp"
+#include "instructions.hpp"
+#include "percpu.hpp"
+#include "pmu.hpp"
+#include "apic/lapic.hpp"
+#include "bootstrap/segments.hpp"
+
+#include "config.hpp"
+#include "libs/logger.hpp"
+#include "libs/string.hpp"
+#include "memory/allocators.hpp"
+
+constexpr uint32_t MSR_PAT = 0x277;
+
+constexpr uint64_t PAGE_PRESENT_WRITE = 0x3;
+constexpr uint64_t PAGE_ADDRESS_MASK  = ~0xfffull;
+
+// MP initialization protocol delays (SDM vol. 3, 9.4.4.1)
+constexpr uint64_t INIT_DELAY_US      = 10'000;
+constexpr uint64_t STARTUP_DELAY_US   = 200;
+constexpr uint64_t ONLINE_TIMEOUT_US  = 100'000;
+
+extern "C"
+{
+    extern const uint8_t smp_trampoline[];
+    extern const uint8_t smp_trampoline_params[];
+    extern const uint8_t smp_trampoline_end[];
+
+    [[noreturn]] void smp_ap_main();
+}
+
+// handed from the BSP to the AP being started
+struct boot_info
+{
+    uint32_t id;
+    uint32_t apic_id;
+    uint64_t pat;
+    bool     online;
+};
+
+// paging enabled from real mode: the trampoline page 1:1 and the higher
+// half. Kernel .bss, so the physical address fits the 32-bit CR3 load.
+alignas(4096) static uint64_t trampoline_pml4_[512];
+alignas(4096) static uint64_t trampoline_pdpt_[512];
+
+static boot_info booting_;
+static uint32_t cpu_count_ = 1;
+
+static void delay_us(uint64_t tsc_hz, uint64_t microsecs)
+{
+    auto wait = (tsc_hz / 1'000'000) * microsecs;
+    auto start = insn::rdtsc();
+    while (insn::rdtsc() - start < wait) {
+        insn::pause();
+    }
+}
+
+static bool wait_online(uint64_t tsc_hz, uint64_t microsecs)
+{
+    auto wait = (tsc_hz / 1'000'000) * microsecs;
+    auto start = insn::rdtsc();
+    while (insn::rdtsc() - start < wait) {
+        if (__atomic_load_n(&booting_.online, __ATOMIC_ACQUIRE)) {
+            return true;
+        }
+        insn::pause();
+    }
+
+    return __atomic_load_n(&booting_.online, __ATOMIC_ACQUIRE);
+}
+
+static smp::trampoline_params *install_trampoline()
+{
+    auto *copy = ptr_to<uint8_t*>(smp::TRAMPOLINE_ADDRESS + KVIRTUAL_ADDRESS);
+    lib::memcpy(copy, smp_trampoline, smp_trampoline_end - smp_trampoline);
+
+    // the higher half is shared with the kernel's tables, the low 1GiB is
+    // the same PDE the kernel maps at 0xffffffff80000000
+    auto cr3 = ptr_from(insn::get_current_page()) & PAGE_ADDRESS_MASK;
+    auto *pml4 = ptr_to<uint64_t*>(cr3 + KVIRTUAL_ADDRESS);
+    auto *pdpt = ptr_to<uint64_t*>((pml4[511] & PAGE_ADDRESS_MASK) + KVIRTUAL_ADDRESS);
+
+    lib::memset(trampoline_pml4_, 0, sizeof(trampoline_pml4_));
+    lib::memset(trampoline_pdpt_, 0, sizeof(trampoline_pdpt_));
+    trampoline_pdpt_[0] = pdpt[510];
+    trampoline_pml4_[0] = kvirt_to_physical(ptr_from(trampoline_pdpt_)) | PAGE_PRESENT_WRITE;
+    trampoline_pml4_[511] = pml4[511];
+
+    auto *params = ptr_to<smp::trampoline_params*>(ptr_from(copy) + (smp_trampoline_params - smp_trampoline));
+    params->cr3 = kvirt_to_physical(ptr_from(trampoline_pml4_));
+    params->kernel_cr3 = cr3;
+
+    return params;
+}
+
+static bool start_ap(smp::trampoline_params *params, uintptr_t stack, uint32_t id,
+                     uint32_t apic_id, uint64_t tsc_hz)
+{
+    // stacks grow down, keep the top 16-byte aligned for the ABI
+    params->stack = (stack + KSTACK_SIZE) & ~0xfull;
+
+    booting_.id      = id;
+    booting_.apic_id = apic_id;
+    booting_.pat     = insn::rdmsr(MSR_PAT);
+    __atomic_store_n(&booting_.online, false, __ATOMIC_RELEASE);
+
+    auto page = static_cast<uint8_t>(smp::TRAMPOLINE_ADDRESS >> 12);
+
+    lapic::send_init(apic_id);
+    delay_us(tsc_hz, INIT_DELAY_US);
+
+    lapic::send_startup(apic_id, page);
+    if (wait_online(tsc_hz, STARTUP_DELAY_US)) {
+        return true;
+    }
+
+    // a STARTUP can be lost, the protocol sends it twice
+    lapic::send_startup(apic_id, page);
+    if (wait_online(tsc_hz, ONLINE_TIMEOUT_US)) {
+        return true;
+    }
+
+    // park it in wait-for-SIPI, a late start would run on a stack that
+    // is handed to the next cpu
+    lapic::send_init(apic_id);
+    return false;
+}
+
+uint32_t smp::start(const acpi::madt_info *madt, uint64_t tsc_hz)
+{
+    if (madt == nullptr || !lapic::enabled() || tsc_hz == 0) {
+        return cpu_count_;
+    }
+
+    auto *params = install_trampoline();
+    auto bsp = lapic::id();
+
+    // placement memory can't be freed, a cpu that doesn't start leaves
+    // its stack to the next one
+    uintptr_t stack = 0;
+
+    for (uint32_t i = 0; i < madt->cpu_count && cpu_count_ < MAX_CPUS; i++) {
+        auto apic_id = madt->apic_ids[i];
+        if (apic_id == bsp) {
+            continue;
+        }
+
+        if (stack == 0) {
+            stack = ptr_from(placement_kalloc(KSTACK_SIZE, true));
+        }
+
+        if (!start_ap(params, stack, cpu_count_, apic_id, tsc_hz)) {
+            lib::log(lib::log_level::WARNING, "SMP: apic id {} didn't start", apic_id);
+            continue;
+        }
+
+        stack = 0;
+        cpu_count_++;
+    }
+
+    lib::log(lib::log_level::INFO, "SMP: {} cpus online", cpu_count_);
+    return cpu_count_;
+}
+
+uint32_t smp::cpu_count()
+{
+    return cpu_count_;
+}
+
+extern "C" void smp_ap_main()
+{
+    auto id = booting_.id;
+
+    // no logging before percpu::setup(), the GS base is still zero
+    gdt_setup(id);
+    idt_load();
+    percpu::setup(id, booting_.apic_id);
+    tss_setup(id, percpu::get()->kernel_stack);
+    syscall_setup();
+
+    // same memory types as the BSP, the framebuffer may use WC already
+    insn::wrmsr(MSR_PAT, booting_.pat);
+
+    fpu::setup_ap();
+    lapic::setup_ap();
+    pmu::setup_ap();
+
+    lib::log(lib::log_level::INFO, "SMP: cpu {} online, apic id {}", id, booting_.apic_id);
+    __atomic_store_n(&booting_.online, true, __ATOMIC_RELEASE);
+
+    // nothing is routed here yet, wake up only for IPIs
+    while (true) {
+        insn::sti();
+        insn::hlt();
+    }
+}
\ No newline at end of file
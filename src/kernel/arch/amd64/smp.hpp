@@ -0,0 +1,44 @@
+#ifndef SMP_HPP
+#define SMP_HPP
+
+#include "libs/stdint.hpp"
+#include "drivers/acpi/acpi.hpp"
+
+/*
+ * Application processor bring-up
+ *
+ * start() wakes every enabled LAPIC listed in the MADT, one at a time:
+ *
+ *   BSP                                    AP
+ *   copy trampoline to 0x8000
+ *   INIT, wait 10ms
+ *   STARTUP (0x08), wait for online  ---> real mode at 0x8000 (trampoline.S)
+ *   (second STARTUP if it didn't)          protected, long mode, higher half
+ *                                          GDT, TSS, IDT, GS base, LAPIC ...
+ *                               <--------  online = true
+ *   next AP                                idle loop
+ *
+ * Each AP gets logical id 1, 2, ... in MADT order, its own GDT, TSS and
+ * kernel stacks and a percpu_t reached through its GS base. The APs only
+ * idle for now: interrupts stay routed to the BSP and the scheduler keeps
+ * running every task there.
+ */
+namespace smp
+{
+    constexpr uintptr_t TRAMPOLINE_ADDRESS = 0x8000;
+
+    // layout of smp_trampoline_params in trampoline.S
+    struct trampoline_params
+    {
+        uint64_t cr3;           // tables the AP enables paging with
+        uint64_t kernel_cr3;    // tables it moves to in the higher half
+        uint64_t stack;
+    };
+
+    // returns how many cpus are online, the BSP included
+    uint32_t start(const acpi::madt_info *madt, uint64_t tsc_hz);
+
+    uint32_t cpu_count();
+}
+
+#endif // SMP_HPP
\ No newline at end of file
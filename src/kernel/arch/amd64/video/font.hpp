@@ -0,0 +1,13 @@
+#ifndef FONT_HPP
+#define FONT_HPP
+
+#include "libs/stdint.hpp"
+
+constexpr uint8_t FONT_FIRST  = 0x20;
+constexpr uint8_t FONT_LAST   = 0x7e;
+constexpr size_t  FONT_GLYPHS = FONT_LAST - FONT_FIRST + 1;
+constexpr size_t  FONT_LINES  = 8;
+
+extern const uint8_t font8x8[FONT_GLYPHS][FONT_LINES];
+
+#endif // FONT_HPP
\ No newline at end of file
@@ -0,0 +1,254 @@
+#include "framebuffer.hpp"
+#include "font.hpp"
+
+#include "libs/multiboot.hpp"
+#include "memory/allocators.hpp"
+#include "arch/amd64/memory/paging.hpp"
+
+constexpr uint16_t CLEAN = 0xffff;
+
+// the 16 text mode colors
+static const uint32_t vga_palette[] = {
+    0x000000, 0x0000aa, 0x00aa00, 0x00aaaa, 0xaa0000, 0xaa00aa, 0xaa5500, 0xaaaaaa,
+    0x555555, 0x5555ff, 0x55ff55, 0x55ffff, 0xff5555, 0xff55ff, 0xffff55, 0xffffff,
+};
+
+static void copy_qwords(uint64_t *dest, const uint64_t *src, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        dest[i] = src[i];
+    }
+}
+
+static void zero_qwords(uint64_t *dest, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        dest[i] = 0;
+    }
+}
+
+framebuffer::framebuffer() : iprotected_mode()
+{
+}
+
+bool framebuffer::setup(const multiboot_info *info)
+{
+    if ((info->flags & MULTIBOOT_INFO_FRAMEBUFFER_INFO) == 0 ||
+        info->framebuffer_type != MULTIBOOT_FRAMEBUFFER_TYPE_RGB ||
+        info->framebuffer_bpp != 32) {
+        return false;
+    }
+
+    if (info->framebuffer_red_mask_size != 8 ||
+        info->framebuffer_green_mask_size != 8 ||
+        info->framebuffer_blue_mask_size != 8) {
+        return false;
+    }
+
+    red_shift_   = info->framebuffer_red_field_position;
+    green_shift_ = info->framebuffer_green_field_position;
+    blue_shift_  = info->framebuffer_blue_field_position;
+
+    // col_/lin_ are 8 bits wide
+    columns_ = info->framebuffer_width / GLYPH_WIDTH;
+    columns_ = (columns_ > 0xff) ? 0xff : columns_;
+    rows_ = info->framebuffer_height / GLYPH_HEIGHT;
+    rows_ = (rows_ > MAX_ROWS) ? MAX_ROWS : rows_;
+    if (columns_ == 0 || rows_ == 0) {
+        return false;
+    }
+
+    pitch_ = info->framebuffer_pitch;
+    line_size_ = columns_ * GLYPH_WIDTH * sizeof(uint32_t);
+    row_size_ = line_size_ * GLYPH_HEIGHT;
+
+    shadow_ = static_cast<uint8_t*>(memory::kmalloc(rows_ * row_size_));
+    glyphs_ = static_cast<uint64_t*>(memory::kmalloc(FONT_GLYPHS * GLYPH_HEIGHT * GLYPH_QWORDS * sizeof(uint64_t)));
+    if (shadow_ == nullptr || glyphs_ == nullptr) {
+        memory::kfree(shadow_);
+        memory::kfree(glyphs_);
+        shadow_ = nullptr;
+        return false;
+    }
+
+    paging page_mgr;
+    device_ = static_cast<uint8_t*>(page_mgr.map_framebuffer(info->framebuffer_addr,
+                                                             pitch_ * info->framebuffer_height));
+    if (device_ == nullptr) {
+        memory::kfree(shadow_);
+        memory::kfree(glyphs_);
+        shadow_ = nullptr;
+        return false;
+    }
+
+    cache_color_ = current_color_;
+    cached_[0] = cached_[1] = 0;
+
+    clear();
+    return true;
+}
+
+bool framebuffer::enabled() const
+{
+    return device_ != nullptr;
+}
+
+uint32_t framebuffer::rgb(uint8_t color) const
+{
+    uint32_t value = vga_palette[color & 0xf];
+
+    return ((value >> 16) & 0xff) << red_shift_ |
+           ((value >> 8) & 0xff) << green_shift_ |
+           (value & 0xff) << blue_shift_;
+}
+
+const uint64_t *framebuffer::glyph(char c)
+{
+    auto code = static_cast<uint8_t>(c);
+    size_t index = (code >= FONT_FIRST && code <= FONT_LAST) ? code - FONT_FIRST : 0;
+
+    // a new color invalidates every rendered glyph
+    if (cache_color_ != current_color_) {
+        cache_color_ = current_color_;
+        cached_[0] = cached_[1] = 0;
+    }
+
+    uint64_t *lines = &glyphs_[index * GLYPH_HEIGHT * GLYPH_QWORDS];
+    if (cached_[index / 64] & (1ull << (index % 64))) {
+        return lines;
+    }
+
+    uint64_t fg = rgb(cache_color_);
+
+    // each font line is drawn twice, two pixels per qword, leftmost in
+    // the low half since the framebuffer is little endian
+    for (size_t y = 0; y < GLYPH_HEIGHT; y++) {
+        uint8_t bits = font8x8[index][y / 2];
+
+        for (size_t q = 0; q < GLYPH_QWORDS; q++) {
+            uint64_t left  = (bits & (1 << (q * 2))) ? fg : 0;
+            uint64_t right = (bits & (1 << (q * 2 + 1))) ? fg : 0;
+            lines[y * GLYPH_QWORDS + q] = left | right << 32;
+        }
+    }
+
+    cached_[index / 64] |= 1ull << (index % 64);
+    return lines;
+}
+
+uint8_t *framebuffer::shadow_row(size_t row)
+{
+    return shadow_ + ((top_ + row) % rows_) * row_size_;
+}
+
+void framebuffer::mark_dirty(size_t row, size_t first, size_t last)
+{
+    if (dirty_first_[row] == CLEAN || first < dirty_first_[row]) {
+        dirty_first_[row] = static_cast<uint16_t>(first);
+    }
+
+    if (dirty_last_[row] == CLEAN || last > dirty_last_[row]) {
+        dirty_last_[row] = static_cast<uint16_t>(last);
+    }
+}
+
+void framebuffer::clear_row(size_t row)
+{
+    zero_qwords(reinterpret_cast<uint64_t*>(shadow_row(row)), row_size_ / sizeof(uint64_t));
+    mark_dirty(row, 0, columns_ - 1);
+}
+
+void framebuffer::scroll_down()
+{
+    top_ = (top_ + 1) % rows_;
+    clear_row(rows_ - 1);
+
+    // every row now shows different pixels
+    for (size_t y = 0; y < rows_; y++) {
+        mark_dirty(y, 0, columns_ - 1);
+    }
+
+    lin_ = static_cast<uint8_t>(rows_ - 1);
+}
+
+void framebuffer::new_line()
+{
+    col_ = 0;
+    lin_++;
+    if (lin_ >= rows_) {
+        scroll_down();
+    }
+}
+
+void framebuffer::clear()
+{
+    current_color_ = colors::GRAY;
+
+    top_ = 0;
+    for (size_t y = 0; y < rows_; y++) {
+        dirty_first_[y] = dirty_last_[y] = CLEAN;
+        clear_row(y);
+    }
+
+    lin_ = 0;
+    col_ = 0;
+
+    flush();
+}
+
+void framebuffer::flush()
+{
+    constexpr size_t CELL_SIZE = GLYPH_WIDTH * sizeof(uint32_t);
+
+    for (size_t y = 0; y < rows_; y++) {
+        if (dirty_first_[y] == CLEAN) {
+            continue;
+        }
+
+        size_t offset = dirty_first_[y] * CELL_SIZE;
+        size_t qwords = (dirty_last_[y] - dirty_first_[y] + 1) * CELL_SIZE / sizeof(uint64_t);
+
+        auto *src = shadow_row(y) + offset;
+        auto *dst = device_ + y * GLYPH_HEIGHT * pitch_ + offset;
+
+        for (size_t line = 0; line < GLYPH_HEIGHT; line++) {
+            copy_qwords(reinterpret_cast<uint64_t*>(dst + line * pitch_),
+                        reinterpret_cast<const uint64_t*>(src + line * line_size_), qwords);
+        }
+
+        dirty_first_[y] = dirty_last_[y] = CLEAN;
+    }
+}
+
+void framebuffer::printc(char c)
+{
+    if (c == '\n' || c == '\r') {
+        new_line();
+        flush();
+        return;
+    }
+
+    const uint64_t *lines = glyph(c);
+    uint8_t *cell = shadow_row(lin_) + col_ * GLYPH_WIDTH * sizeof(uint32_t);
+
+    for (size_t y = 0; y < GLYPH_HEIGHT; y++) {
+        copy_qwords(reinterpret_cast<uint64_t*>(cell + y * line_size_), &lines[y * GLYPH_QWORDS], GLYPH_QWORDS);
+    }
+
+    mark_dirty(lin_, col_, col_);
+
+    col_++;
+    if (col_ >= columns_) {
+        new_line();
+    }
+}
+
+void framebuffer::prints(const char *s)
+{
+    while (*s) {
+        printc(*s);
+        s++;
+    }
+
+    flush();
+}
\ No newline at end of file
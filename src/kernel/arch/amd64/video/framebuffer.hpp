@@ -0,0 +1,74 @@
+#ifndef FRAMEBUFFER_HPP
+#define FRAMEBUFFER_HPP
+
+#include "libs/stdint.hpp"
+#include "arch/iarch.hpp"
+
+/*
+ * Linear framebuffer console
+ *
+ * Text console drawn on a 32 bpp RGB framebuffer with the 8x8 font scaled
+ * to 8x16 cells. Glyphs are rendered once per color into a cache of ready
+ * to copy pixel lines, so drawing a character is 16 lines of four 64-bit
+ * stores into a RAM shadow of the screen.
+ *
+ * Like protected_mode, the shadow is a ring of text rows starting at top_,
+ * scrolling only blanks a row, and flush() copies the dirty column span of
+ * each dirty row to the device. The device is mapped write-combining, so
+ * those copies go out as full bursts.
+ */
+class framebuffer : public iprotected_mode
+{
+    static constexpr size_t GLYPH_WIDTH  = 8;
+    static constexpr size_t GLYPH_HEIGHT = 16;
+    static constexpr size_t MAX_ROWS     = 128;
+
+    // one glyph line, 8 pixels of 4 bytes
+    static constexpr size_t GLYPH_QWORDS = GLYPH_WIDTH * sizeof(uint32_t) / sizeof(uint64_t);
+
+    uint8_t *device_ = nullptr;
+    uint8_t *shadow_ = nullptr;
+    uint64_t *glyphs_ = nullptr;
+
+    uint32_t pitch_ = 0;
+    uint32_t columns_ = 0;
+    uint32_t rows_ = 0;
+
+    // bytes per shadow scanline and per text row
+    size_t line_size_ = 0;
+    size_t row_size_ = 0;
+
+    uint8_t red_shift_ = 0;
+    uint8_t green_shift_ = 0;
+    uint8_t blue_shift_ = 0;
+
+    // glyphs_ holds glyphs drawn in this color, cached_ says which
+    uint8_t cache_color_ = 0;
+    uint64_t cached_[2] = {};
+
+    uint32_t top_ = 0;
+    uint16_t dirty_first_[MAX_ROWS];
+    uint16_t dirty_last_[MAX_ROWS];
+
+private:
+    uint32_t rgb(uint8_t color) const;
+    const uint64_t *glyph(char c);
+    uint8_t *shadow_row(size_t row);
+    void mark_dirty(size_t row, size_t first, size_t last);
+    void clear_row(size_t row);
+    void new_line();
+    void scroll_down();
+
+public:
+    framebuffer();
+
+    bool setup(const multiboot_info *info);
+    bool enabled() const;
+
+    void clear() override;
+    void flush() override;
+    void printc(char c) override;
+    void prints(const char *s) override;
+};
+
+#endif // FRAMEBUFFER_HPP
\ No newline at end of file
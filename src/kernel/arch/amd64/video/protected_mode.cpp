@@ -1,63 +1,93 @@
 #include "protected_mode.hpp"
 #include "config.hpp"
-#include "libs/stdlib.hpp"
+#include "libs/string.hpp"
+
+constexpr uint16_t BLANK = ' ' | 1 << 8;
+constexpr uint32_t ALL_LINES = (1u << HEIGHT) - 1;
 
 protected_mode::protected_mode() : iprotected_mode()
 {
 }
 
-void protected_mode::scroll_down()
+uint16_t *protected_mode::shadow_line(size_t row)
 {
-    auto videobuf = reinterpret_cast<uint16_t*>(VGA_VIRTUAL_ADDRESS);
-    for (size_t y = 1; y < HEIGHT; y++) {
-        for (size_t x = 0; x < WIDTH; x++) {
-            videobuf[(y - 1) * WIDTH + x] = videobuf[y * WIDTH + x];
-        }
-    }
+    return &shadow_[((top_ + row) % HEIGHT) * WIDTH];
+}
 
+void protected_mode::clear_line(size_t row)
+{
+    auto line = shadow_line(row);
     for (size_t x = 0; x < WIDTH; x++) {
-        videobuf[(HEIGHT - 1) * WIDTH + x] = ' ' | 1 << 8;
+        line[x] = BLANK;
     }
 
+    dirty_ |= 1u << row;
+}
+
+void protected_mode::scroll_down()
+{
+    // the old top line becomes the new bottom one, every row moved
+    top_ = (top_ + 1) % HEIGHT;
+    clear_line(HEIGHT - 1);
+    dirty_ = ALL_LINES;
+
     lin_ = HEIGHT - 1;
 }
 
+void protected_mode::new_line()
+{
+    col_ = 0;
+    lin_++;
+    if (lin_ >= HEIGHT) {
+        scroll_down();
+    }
+}
+
 void protected_mode::clear()
 {
     current_color_ = colors::GRAY;
 
-    auto videobuf = reinterpret_cast<uint16_t*>(VGA_VIRTUAL_ADDRESS);
+    top_ = 0;
     for (size_t y = 0; y < HEIGHT; y++) {
-        for (size_t x = 0; x < WIDTH; x++) {
-            videobuf[y * WIDTH + x] = ' ' | 1 << 8;
-        }
+        clear_line(y);
     }
 
     lin_ = 0;
     col_ = 0;
+
+    flush();
 }
 
-void protected_mode::printc(char c)
+void protected_mode::flush()
 {
+    if (dirty_ == 0) {
+        return;
+    }
+
     auto videobuf = reinterpret_cast<uint16_t*>(VGA_VIRTUAL_ADDRESS);
+    for (size_t y = 0; y < HEIGHT; y++) {
+        if (dirty_ & (1u << y)) {
+            lib::memcpy(&videobuf[y * WIDTH], shadow_line(y), WIDTH * sizeof(uint16_t));
+        }
+    }
 
+    dirty_ = 0;
+}
+
+void protected_mode::printc(char c)
+{
     if (c == '\n' || c == '\r') {
-        col_ = 0;
-        lin_++;
-        if (lin_ >= HEIGHT) {
-            scroll_down();
-        }
+        new_line();
+        flush();
         return;
     }
 
-    videobuf[lin_ * WIDTH + col_] = c | current_color_ << 8;
+    shadow_line(lin_)[col_] = static_cast<uint16_t>(static_cast<uint8_t>(c) | current_color_ << 8);
+    dirty_ |= 1u << lin_;
+
     col_++;
     if (col_ >= WIDTH) {
-        col_ = 0;
-        lin_++;
-        if (lin_ >= HEIGHT) {
-            scroll_down();
-        }
+        new_line();
     }
 }
 
@@ -67,19 +97,6 @@ void protected_mode::prints(const char *s)
         printc(*s);
         s++;
     }
-}
 
-void protected_mode::printd(int d)
-{
-    char buffer[32];
-    itoa(buffer, 32, d, base::dec);
-    prints(buffer);
-}
-
-void protected_mode::printx(uint64_t x)
-{
-    char buffer[32];
-    itoa(buffer, 32, x, base::hex);
-    prints("0x");
-    prints(buffer);
+    flush();
 }
\ No newline at end of file
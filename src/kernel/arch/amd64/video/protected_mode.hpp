@@ -4,21 +4,47 @@
 #include "libs/stdint.hpp"
 #include "arch/iarch.hpp"
 
+/*
+ * VGA text console
+ *
+ * Characters are written to a shadow copy of the screen in RAM, the VGA
+ * memory is only touched by flush(), which copies the lines that changed
+ * since the last flush one whole line at a time. The shadow is a ring of
+ * HEIGHT lines: scrolling moves top_ and blanks one line instead of moving
+ * 80x24 cells through uncached MMIO.
+ *
+ *      shadow_                    screen
+ *   +------------+             +--------+
+ *   | row 23     |             | row 0  |
+ *   | row 24     |             | row 1  |
+ *   | row 0      | <- top_     | ...    |
+ *   | row 1      |             | row 24 |
+ *   | ...        |             +--------+
+ *   +------------+
+ */
 class protected_mode : public iprotected_mode
 {
-    int16_t buffer_[WIDTH * (HEIGHT * 2)];
+    uint16_t shadow_[WIDTH * HEIGHT];
+
+    // shadow line shown at screen row 0
+    uint8_t top_ = 0;
+
+    // one bit per screen row that differs from VGA memory
+    uint32_t dirty_ = 0;
 
 private:
+    uint16_t *shadow_line(size_t row);
+    void clear_line(size_t row);
+    void new_line();
     void scroll_down();
 
 public:
     protected_mode();
 
     void clear() override;
+    void flush() override;
     void printc(char c) override;
     void prints(const char *s) override;
-    void printd(int d);
-    void printx(uint64_t x);
 };
 
 #endif // PROTECTED_MODE_HPP
\ No newline at end of file
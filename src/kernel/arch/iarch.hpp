@@ -5,17 +5,77 @@
 #include "drivers/peripherals/keyboard.hpp"
 #include "drivers/peripherals/timer.hpp"
 #include "iprotected_mode.hpp"
+#include "drivers/acpi/acpi.hpp"
+
+struct multiboot_info;
 
 class iarch
 {
 public:
+    // sleeps until the next interrupt, call it with interrupts disabled
+    // after checking for work, they are disabled again on return
     virtual void cpu_halt() = 0;
 
+    // masks interrupts on this cpu, the returned state goes back to
+    // irq_restore
+    virtual uint64_t irq_save() = 0;
+    virtual void irq_restore(uint64_t flags) = 0;
+
     virtual iprotected_mode *get_video() = 0;
 
+    // switches get_video() to the bootloader framebuffer, if there is one
+    virtual bool setup_framebuffer(const multiboot_info *info) = 0;
+
+    // adds callback to the chain of vector, context is passed back on every call
+    virtual bool register_interrupt(uint8_t vector, lib::interrupt_callback_t callback, void *context) = 0;
+    virtual bool unregister_interrupt(uint8_t vector, lib::interrupt_callback_t callback, void *context) = 0;
+
+    // vector raised by the legacy ISA irq line
+    virtual uint8_t irq_vector(uint8_t irq) const = 0;
+
+    // free vector for message signaled interrupts, 0 when none is left
+    virtual uint8_t allocate_vector() = 0;
+
+    // moves external interrupts from the legacy controller to the one
+    // described by the MADT
+    virtual bool route_interrupts(const acpi::madt_info *madt) = 0;
+
+    // wakes the other cpus listed in the MADT, returns how many cpus are
+    // online (the boot cpu included), tsc_hz is the calibrated TSC rate
+    virtual uint32_t start_cpus(const acpi::madt_info *madt, uint64_t tsc_hz) = 0;
+
+    // MSI message that delivers vector to the given cpu, the address is 0
+    // when that cpu isn't online
+    virtual uint64_t msi_address(uint32_t cpu) const = 0;
+    virtual uint32_t msi_data(uint8_t vector) const = 0;
+
+    // per-vector interrupt counters and latency histograms
+    virtual void print_interrupt_stats(iprotected_mode *video) = 0;
+
+    // hardware event counters charged to each task
+    virtual void print_task_counters(iprotected_mode *video) = 0;
+
+    // feeds lib::profiler a sample every period unhalted cycles, false when
+    // the cpu has no counter for it
+    virtual bool start_sampling(uint32_t period) = 0;
+    virtual void stop_sampling() = 0;
+    virtual bool sampling() const = 0;
+
+    // uncached mapping of device memory, nullptr once the window is full
+    virtual vaddr_t map_io(uintptr_t addr, size_t size) = 0;
+
+    // cacheable mapping of RAM outside the kernel image, firmware tables
+    virtual vaddr_t map_memory(uintptr_t addr, size_t size) = 0;
+
     virtual void set_keyboard_handler(const keyboard_handler_t *handler) = 0;
     virtual void set_timer_handler(const timer_handler_t *handler) = 0;
 
+    // per-cpu timer, tsc_hz is the calibrated TSC rate
+    virtual bool local_timer_setup(uint64_t tsc_hz) = 0;
+    virtual void local_timer_periodic(uint32_t frequency) = 0;
+    virtual void local_timer_oneshot(uint64_t nanosecs) = 0;
+    virtual void local_timer_stop() = 0;
+
     virtual uint8_t read_byte(uint16_t value_port) const = 0;
     virtual void write_byte(uint16_t value_port, uint8_t value) const = 0;
 
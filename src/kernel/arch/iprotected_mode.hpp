@@ -2,11 +2,15 @@
 #define IPROTECTED_MODE_HPP
 
 #include "libs/stdint.hpp"
+#include "libs/format.hpp"
 #include "libs/type_traits.hpp"
 
 constexpr size_t WIDTH = 80;
 constexpr size_t HEIGHT = 25;
 
+// longest line print() and format() build on the stack
+constexpr size_t PRINT_BUFFER = 256;
+
 class iprotected_mode
 {
 protected:
@@ -25,44 +29,43 @@ public:
         : current_color_(color), col_(0), lin_(0) {}
 
     virtual void clear() = 0;
+    // push buffered output to the device, if the console buffers any
+    virtual void flush() {}
+    // wait until everything printed so far reached the device
+    virtual void drain() { flush(); }
     virtual void printc(char c) = 0;
     virtual void prints(const char *s) = 0;
-    virtual void printd(int d) = 0;
-    virtual void printx(uint64_t x) = 0;
 
-    
-    template <typename T, typename... Args>
-    inline void print(T value, Args... args)
+    // concatenates every argument with its default format, one prints()
+    template <typename... Args>
+    inline void print(Args... args)
+    {
+        char buffer[PRINT_BUFFER];
+        lib::format_buffer out(buffer, sizeof(buffer));
+        lib::format_spec spec;
+
+        (lib::format_value(out, spec, args), ...);
+        prints(out.c_str());
+    }
+
+    // format("{} pages at {:p}", count, addr), see libs/format.hpp
+    template <typename... Args>
+    inline void format(lib::format_string<Args...> fmt, Args... args)
+    {
+        char buffer[PRINT_BUFFER];
+        lib::format_to(buffer, sizeof(buffer), fmt, args...);
+        prints(buffer);
+    }
+
+    void printd(int64_t d)
     {
-        print(value);
-        if constexpr (sizeof...(args) > 0) {
-            print(args...);
-        }
+        format("{}", d);
     }
 
-    template <typename T>
-    inline void print(T value)
+    // 0x prefixed hex
+    void printx(uint64_t x)
     {
-        if constexpr (lib::is_same_v<T, const char*>)
-        {
-            prints(value);
-        }
-        else if constexpr (lib::is_same_v<T, char>)
-        {
-            printc(value);
-        }
-        else if constexpr (lib::is_integral_v<T>)
-        {
-            printd(value);
-        }
-        else if constexpr (lib::is_floating_point_v<T>)
-        {
-            printx(static_cast<uint64_t>(value));
-        }
-        else {
-            prints("Err: ");
-            prints(value);
-        }
+        format("{:p}", x);
     }
 
     void set_color(colors color = colors::GRAY)
@@ -0,0 +1,229 @@
+#include "bench.hpp"
+
+#include "arch/iarch.hpp"
+#include "arch/amd64/instructions.hpp"
+#include "arch/amd64/memory/paging.hpp"
+#include "config.hpp"
+#include "drivers/peripherals/serial.hpp"
+#include "drivers/peripherals/timer.hpp"
+#include "memory/memory_manager.hpp"
+#include "syscall/syscall.hpp"
+#include "task/task.hpp"
+
+// -device isa-debug-exit,iobase=0xf4,iosize=0x04
+constexpr uint16_t DEBUG_EXIT_PORT = 0xf4;
+
+constexpr uint8_t STATUS_OK     = 0;
+constexpr uint8_t STATUS_FAILED = 1;
+
+constexpr uint8_t VECTOR_BREAKPOINT = 3;
+
+constexpr size_t WARMUP     = 64;
+constexpr size_t ITERATIONS = 4096;
+
+struct sample
+{
+    uint64_t min   = ~0ull;
+    uint64_t total = 0;
+};
+
+struct context
+{
+    peripherals::serial *serial;
+    uint64_t tsc_hz;
+    bool failed;
+};
+
+static void report(context &ctx, const char *name, const sample &s)
+{
+    auto avg = s.total / ITERATIONS;
+    auto avg_ns = (ctx.tsc_hz == 0) ? 0 : avg * 1'000'000'000ull / ctx.tsc_hz;
+
+    ctx.serial->format("bench {} iterations={} min_cycles={} avg_cycles={} avg_ns={}\n",
+                       name, ITERATIONS, s.min, avg, avg_ns);
+}
+
+// op() returns the cycles of one repetition, the warmup runs aren't counted
+template <typename Op>
+static void measure(context &ctx, const char *name, Op op)
+{
+    sample s;
+
+    for (size_t i = 0; i < WARMUP; i++) {
+        op();
+    }
+
+    for (size_t i = 0; i < ITERATIONS; i++) {
+        auto cycles = op();
+        s.min = (cycles < s.min) ? cycles : s.min;
+        s.total += cycles;
+    }
+
+    report(ctx, name, s);
+}
+
+// times a single call, including the rdtsc pair (see tsc_overhead)
+template <typename Fn>
+static uint64_t timed(Fn fn)
+{
+    auto start = insn::rdtsc();
+    fn();
+    return insn::rdtsc() - start;
+}
+
+static void frame_alloc(context &ctx)
+{
+    auto *frames = memory::g_physical_manager;
+
+    measure(ctx, "frame_alloc", [&] {
+        paddr_t frame = nullptr;
+        auto cycles = timed([&] {
+            frame = frames->alloc();
+            frames->free(frame);
+        });
+
+        ctx.failed |= (frame == nullptr);
+        return cycles;
+    });
+}
+
+static void kmalloc(context &ctx)
+{
+    measure(ctx, "kmalloc", [&] {
+        void *ptr = nullptr;
+        auto cycles = timed([&] {
+            ptr = memory::kmalloc(64);
+            memory::kfree(ptr);
+        });
+
+        ctx.failed |= (ptr == nullptr);
+        return cycles;
+    });
+}
+
+static void page_map(context &ctx)
+{
+    auto frame = memory::g_physical_manager->alloc();
+    auto page = memory::g_kernel_virtual_manager->alloc(FRAME_SIZE);
+    if (frame == nullptr || page == nullptr) {
+        ctx.failed = true;
+        return;
+    }
+
+    paging pages;
+
+    measure(ctx, "page_map", [&] {
+        int result = 0;
+        auto cycles = timed([&] {
+            result = pages.map(page, frame, 0x03);
+            pages.unmap(page);
+        });
+
+        ctx.failed |= (result != 0);
+        return cycles;
+    });
+
+    memory::g_kernel_virtual_manager->free(page, FRAME_SIZE);
+    memory::g_physical_manager->free(frame);
+}
+
+// int3 with an empty handler: the whole stub, dispatch and iretq path
+// without an interrupt controller acknowledge
+static void interrupt_round_trip(context &ctx, iarch *arch)
+{
+    auto handler = [](const interrupt_t &, void *) {};
+
+    if (!arch->register_interrupt(VECTOR_BREAKPOINT, handler, nullptr)) {
+        ctx.failed = true;
+        return;
+    }
+
+    measure(ctx, "interrupt", [] {
+        return timed([] { asm volatile("int3" : : : "memory"); });
+    });
+
+    arch->unregister_interrupt(VECTOR_BREAKPOINT, handler, nullptr);
+}
+
+// int 0x80 with an out of range number, syscall_dispatch returns ENOSYS
+// right away. SYSCALL itself can't be issued from ring 0, sysretq would
+// land in ring 3.
+static void syscall_round_trip(context &ctx)
+{
+    measure(ctx, "syscall", [&] {
+        uint64_t result = 0;
+        auto cycles = timed([&] {
+            asm volatile("int $0x80"
+                         : "=a"(result)
+                         : "a"(syscall::SYS_COUNT)
+                         : "memory");
+        });
+
+        ctx.failed |= (result != static_cast<uint64_t>(-syscall::ENOSYS));
+        return cycles;
+    });
+}
+
+static bool switching_;
+
+static void switch_partner(void *)
+{
+    auto &tasks = get_task_manager();
+
+    while (__atomic_load_n(&switching_, __ATOMIC_ACQUIRE)) {
+        tasks.yield();
+    }
+
+    tasks.exit();
+}
+
+// the idle task yields to a thread that yields straight back: two
+// switches per repetition, reported per switch
+static void context_switch(context &ctx)
+{
+    auto &tasks = get_task_manager();
+
+    __atomic_store_n(&switching_, true, __ATOMIC_RELEASE);
+    if (tasks.create_kernel_thread(switch_partner, nullptr) == nullptr) {
+        ctx.failed = true;
+        return;
+    }
+
+    measure(ctx, "context_switch", [&] {
+        return timed([&] { tasks.yield(); }) / 2;
+    });
+
+    __atomic_store_n(&switching_, false, __ATOMIC_RELEASE);
+    tasks.yield();
+}
+
+void bench::run(iarch *arch, peripherals::serial *serial, peripherals::timer &timer)
+{
+    // nothing to report to, fail right away
+    uint8_t status = STATUS_FAILED;
+
+    if (serial != nullptr) {
+        context ctx = { serial, timer.get_tsc_frequency(), false };
+
+        serial->format("bench begin tsc_hz={}\n", ctx.tsc_hz);
+
+        measure(ctx, "tsc_overhead", [] { return timed([] {}); });
+        frame_alloc(ctx);
+        kmalloc(ctx);
+        page_map(ctx);
+        interrupt_round_trip(ctx, arch);
+        syscall_round_trip(ctx);
+        context_switch(ctx);
+
+        status = ctx.failed ? STATUS_FAILED : STATUS_OK;
+        serial->format("bench end status={}\n", ctx.failed ? "failed" : "ok");
+        serial->drain();
+    }
+
+    arch->write_byte(DEBUG_EXIT_PORT, status);
+
+    // not under QEMU or started without isa-debug-exit
+    while (true) {
+        arch->cpu_halt();
+    }
+}
\ No newline at end of file
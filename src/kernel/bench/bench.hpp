@@ -0,0 +1,35 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include "libs/stdint.hpp"
+
+class iarch;
+
+namespace peripherals
+{
+    class serial;
+    class timer;
+}
+
+/*
+ * Boot time microbenchmarks (coronel-bench)
+ *
+ * Built into the coronel-bench variant only: kmain calls run() once the
+ * interrupts, the timer and COM1 are up. Each benchmark repeats one
+ * operation and times every repetition with RDTSC, the results go to
+ * COM1 one per line:
+ *
+ *     bench begin tsc_hz=2400000000
+ *     bench kmalloc iterations=4096 min_cycles=182 avg_cycles=240 avg_ns=100
+ *     ...
+ *     bench end status=ok
+ *
+ * Then the status is written to the isa-debug-exit port, QEMU exits with
+ * (status << 1) | 1: 1 when every benchmark ran, 3 otherwise.
+ */
+namespace bench
+{
+    [[noreturn]] void run(iarch *arch, peripherals::serial *serial, peripherals::timer &timer);
+}
+
+#endif // BENCH_HPP
\ No newline at end of file
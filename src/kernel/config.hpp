@@ -7,7 +7,9 @@
 #ifndef __ASSEMBLER__
     #include "libs/stdint.hpp"
 
+    // map_io window, the last GiB of the address space
     constexpr uintptr_t PCI_VIRTUAL_ADDRESS = KVIRTUAL_ADDRESS + 0x40000000;
+    constexpr size_t    PCI_VIRTUAL_SIZE    = 1_GB;
 
     constexpr size_t   MAX_KERNEL_SIZE = 32_MB;
 
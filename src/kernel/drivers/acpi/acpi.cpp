@@ -0,0 +1,302 @@
+#include "acpi.hpp"
+
+#include "arch/iarch.hpp"
+#include "libs/logger.hpp"
+#include "libs/string.hpp"
+
+// the BIOS data area keeps the EBDA segment at 0x40e
+constexpr uintptr_t BDA_EBDA_SEGMENT = 0x40e;
+constexpr size_t    EBDA_SCAN_SIZE   = 1_KB;
+constexpr uintptr_t BIOS_AREA_START  = 0xe0000;
+constexpr uintptr_t BIOS_AREA_END    = 0x100000;
+
+// the RSDP is always 16-byte aligned
+constexpr size_t RSDP_ALIGNMENT = 16;
+
+enum MADT_ENTRY {
+    MADT_LOCAL_APIC        = 0,
+    MADT_IOAPIC            = 1,
+    MADT_SOURCE_OVERRIDE   = 2,
+    MADT_LOCAL_APIC_NMI    = 4,
+    MADT_LAPIC_OVERRIDE    = 5
+};
+
+constexpr uint32_t MADT_PCAT_COMPAT  = 1u << 0;
+constexpr uint32_t LAPIC_ENABLED     = 1u << 0;
+
+struct rsdp_t
+{
+    char     signature[8];
+    uint8_t  checksum;
+    char     oem[6];
+    uint8_t  revision;
+    uint32_t rsdt;
+
+    // ACPI 2.0+
+    uint32_t length;
+    uint64_t xsdt;
+    uint8_t  extended_checksum;
+    uint8_t  reserved[3];
+} __attribute__((packed));
+
+struct sdt_header
+{
+    char     signature[4];
+    uint32_t length;
+    uint8_t  revision;
+    uint8_t  checksum;
+    char     oem[6];
+    char     oem_table[8];
+    uint32_t oem_revision;
+    uint32_t creator;
+    uint32_t creator_revision;
+} __attribute__((packed));
+
+struct madt_header
+{
+    sdt_header header;
+    uint32_t   lapic_address;
+    uint32_t   flags;
+} __attribute__((packed));
+
+struct madt_entry
+{
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed));
+
+struct madt_local_apic
+{
+    madt_entry entry;
+    uint8_t    processor_id;
+    uint8_t    apic_id;
+    uint32_t   flags;
+} __attribute__((packed));
+
+struct madt_ioapic
+{
+    madt_entry entry;
+    uint8_t    id;
+    uint8_t    reserved;
+    uint32_t   address;
+    uint32_t   gsi_base;
+} __attribute__((packed));
+
+struct madt_source_override
+{
+    madt_entry entry;
+    uint8_t    bus;
+    uint8_t    source;
+    uint32_t   gsi;
+    uint16_t   flags;
+} __attribute__((packed));
+
+struct madt_lapic_override
+{
+    madt_entry entry;
+    uint16_t   reserved;
+    uint64_t   address;
+} __attribute__((packed));
+
+static acpi::madt_info madt_;
+static bool has_madt_ = false;
+
+static bool signature_is(const char *signature, const char *expected, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        if (signature[i] != expected[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool checksum_ok(const void *table, size_t size)
+{
+    auto *bytes = static_cast<const uint8_t*>(table);
+    uint8_t sum = 0;
+
+    for (size_t i = 0; i < size; i++) {
+        sum += bytes[i];
+    }
+
+    return sum == 0;
+}
+
+static const rsdp_t *scan_rsdp(uintptr_t start, uintptr_t end)
+{
+    for (uintptr_t addr = start; addr < end; addr += RSDP_ALIGNMENT) {
+        auto *rsdp = ptr_to<const rsdp_t*>(KVIRTUAL_ADDRESS + addr);
+        if (signature_is(rsdp->signature, "RSD PTR ", 8) && checksum_ok(rsdp, 20)) {
+            return rsdp;
+        }
+    }
+
+    return nullptr;
+}
+
+static const rsdp_t *find_rsdp()
+{
+    auto ebda = static_cast<uintptr_t>(*ptr_to<const uint16_t*>(KVIRTUAL_ADDRESS + BDA_EBDA_SEGMENT)) << 4;
+    if (ebda != 0) {
+        if (auto *rsdp = scan_rsdp(ebda, ebda + EBDA_SCAN_SIZE)) {
+            return rsdp;
+        }
+    }
+
+    return scan_rsdp(BIOS_AREA_START, BIOS_AREA_END);
+}
+
+// tables can live anywhere in physical memory, a header mapping covers up
+// to the end of its last page so most tables need no other
+static const sdt_header *map_header(iarch *arch, uintptr_t addr)
+{
+    return static_cast<const sdt_header*>(arch->map_memory(addr, sizeof(sdt_header)));
+}
+
+// header is what map_header returned for addr, only a table running past
+// it is mapped again at its full length
+static const sdt_header *map_table(iarch *arch, uintptr_t addr, const sdt_header *header)
+{
+    if (header == nullptr) {
+        return nullptr;
+    }
+
+    auto length = header->length;
+    if (length < sizeof(sdt_header)) {
+        return nullptr;
+    }
+
+    if (addr + length > ALIGN_UP(addr + sizeof(sdt_header))) {
+        header = static_cast<const sdt_header*>(arch->map_memory(addr, length));
+        if (header == nullptr) {
+            return nullptr;
+        }
+    }
+
+    if (!checksum_ok(header, length)) {
+        return nullptr;
+    }
+
+    return header;
+}
+
+static const sdt_header *find_table(iarch *arch, const rsdp_t *rsdp, const char *signature)
+{
+    bool extended = rsdp->revision >= 2 && rsdp->xsdt != 0;
+    uintptr_t root_addr = extended ? rsdp->xsdt : rsdp->rsdt;
+    auto *root = map_table(arch, root_addr, map_header(arch, root_addr));
+    if (root == nullptr) {
+        return nullptr;
+    }
+
+    // entries follow the header: 64-bit pointers in the XSDT, 32-bit in the RSDT
+    size_t entry_size = extended ? sizeof(uint64_t) : sizeof(uint32_t);
+    size_t entries = (root->length - sizeof(sdt_header)) / entry_size;
+    auto *base = reinterpret_cast<const uint8_t*>(root + 1);
+
+    for (size_t i = 0; i < entries; i++) {
+        uint64_t addr;
+        if (extended) {
+            lib::memcpy(&addr, base + i * entry_size, sizeof(uint64_t));
+        }
+        else {
+            uint32_t addr32;
+            lib::memcpy(&addr32, base + i * entry_size, sizeof(uint32_t));
+            addr = addr32;
+        }
+
+        auto *header = map_header(arch, addr);
+        if (header == nullptr) {
+            return nullptr;
+        }
+
+        if (signature_is(header->signature, signature, 4)) {
+            return map_table(arch, addr, header);
+        }
+    }
+
+    return nullptr;
+}
+
+static void parse_madt(const madt_header *madt)
+{
+    lib::memset(&madt_, 0, sizeof(madt_));
+    madt_.lapic_address = madt->lapic_address;
+    madt_.legacy_pics = (madt->flags & MADT_PCAT_COMPAT) != 0;
+
+    auto *ptr = reinterpret_cast<const uint8_t*>(madt + 1);
+    auto *end = reinterpret_cast<const uint8_t*>(madt) + madt->header.length;
+
+    while (ptr + sizeof(madt_entry) <= end) {
+        auto *entry = reinterpret_cast<const madt_entry*>(ptr);
+        if (entry->length < sizeof(madt_entry)) {
+            break;
+        }
+
+        switch (entry->type) {
+            case MADT_ENTRY::MADT_LOCAL_APIC: {
+                auto *lapic = reinterpret_cast<const madt_local_apic*>(entry);
+                // online capable but disabled processors are hot-plug slots,
+                // nothing answers an INIT sent to them
+                if ((lapic->flags & LAPIC_ENABLED) && madt_.cpu_count < MAX_CPUS) {
+                    madt_.apic_ids[madt_.cpu_count++] = lapic->apic_id;
+                }
+                break;
+            }
+
+            case MADT_ENTRY::MADT_IOAPIC: {
+                auto *ioapic = reinterpret_cast<const madt_ioapic*>(entry);
+                if (madt_.ioapic_count < acpi::MAX_IOAPICS) {
+                    madt_.ioapics[madt_.ioapic_count++] = { ioapic->id, ioapic->address, ioapic->gsi_base };
+                }
+                break;
+            }
+
+            case MADT_ENTRY::MADT_SOURCE_OVERRIDE: {
+                auto *iso = reinterpret_cast<const madt_source_override*>(entry);
+                if (madt_.override_count < acpi::MAX_OVERRIDES) {
+                    madt_.overrides[madt_.override_count++] = { iso->source, iso->gsi, iso->flags };
+                }
+                break;
+            }
+
+            case MADT_ENTRY::MADT_LAPIC_OVERRIDE: {
+                auto *lapic_override = reinterpret_cast<const madt_lapic_override*>(entry);
+                madt_.lapic_address = lapic_override->address;
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        ptr += entry->length;
+    }
+}
+
+bool acpi::setup(iarch *arch)
+{
+    auto *rsdp = find_rsdp();
+    if (rsdp == nullptr) {
+        lib::log(lib::log_level::WARNING, "ACPI: RSDP not found");
+        return false;
+    }
+
+    auto *madt = find_table(arch, rsdp, "APIC");
+    if (madt == nullptr) {
+        lib::log(lib::log_level::WARNING, "ACPI: MADT not found");
+        return false;
+    }
+
+    parse_madt(reinterpret_cast<const madt_header*>(madt));
+    has_madt_ = true;
+
+    return true;
+}
+
+const acpi::madt_info *acpi::get_madt()
+{
+    return has_madt_ ? &madt_ : nullptr;
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef ACPI_HPP
+#define ACPI_HPP
+
+class iarch;
+
+#include "libs/stdint.hpp"
+#include "config.hpp"
+
+/*
+ * ACPI tables
+ *
+ * Only what the interrupt routing needs is parsed: the RSDP is looked up in
+ * the EBDA and in the BIOS area (0xe0000 - 0xfffff), the XSDT (or RSDT on
+ * ACPI 1.0) is walked and the MADT ("APIC") is decoded into madt_info.
+ *
+ *   RSDP --> XSDT --> MADT --+-- local APIC (one per cpu)
+ *                   |        +-- IOAPIC (address, first GSI)
+ *                  ...       +-- interrupt source override (ISA irq -> GSI)
+ */
+namespace acpi
+{
+    constexpr size_t MAX_IOAPICS   = 8;
+    constexpr size_t MAX_OVERRIDES = 16;
+
+    // MPS INTI flags used by interrupt source overrides
+    constexpr uint16_t POLARITY_MASK     = 0x3;
+    constexpr uint16_t POLARITY_LOW      = 0x3;
+    constexpr uint16_t TRIGGER_MASK      = 0xc;
+    constexpr uint16_t TRIGGER_LEVEL     = 0xc;
+
+    struct ioapic_info
+    {
+        uint8_t  id;
+        uint32_t address;
+        uint32_t gsi_base;      // first global system interrupt it serves
+    };
+
+    struct override_info
+    {
+        uint8_t  source;        // ISA irq
+        uint32_t gsi;
+        uint16_t flags;         // polarity and trigger mode
+    };
+
+    struct madt_info
+    {
+        uint64_t lapic_address;
+        bool     legacy_pics;   // 8259 pair present and must be masked
+
+        uint32_t cpu_count;
+        uint8_t  apic_ids[MAX_CPUS];
+
+        uint32_t ioapic_count;
+        ioapic_info ioapics[MAX_IOAPICS];
+
+        uint32_t override_count;
+        override_info overrides[MAX_OVERRIDES];
+    };
+
+    bool setup(iarch *arch);
+
+    // nullptr when no MADT was found
+    const madt_info *get_madt();
+}
+
+#endif // ACPI_HPP
\ No newline at end of file
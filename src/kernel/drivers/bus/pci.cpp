@@ -5,6 +5,8 @@ constexpr uint8_t MAX_PCI_SLOTS    = 32;
 
 constexpr unsigned PCI_VENDOR_ID     = 0x00;
 constexpr unsigned PCI_DEVICE_ID     = 0x02;
+constexpr unsigned PCI_COMMAND       = 0x04;
+constexpr unsigned PCI_STATUS        = 0x06;
 constexpr unsigned PCI_SUBCLASS      = 0x0a;
 constexpr unsigned PCI_CLASS         = 0x0b;
 constexpr unsigned PCI_HEADER_TYPE   = 0x0e;
@@ -16,10 +18,49 @@ constexpr unsigned PCI_BAR_3         = 0x1c;
 constexpr unsigned PCI_BAR_4         = 0x20;
 constexpr unsigned PCI_BAR_5         = 0x24;
 
+constexpr unsigned PCI_CAPABILITIES  = 0x34;
+
 constexpr unsigned PCI_SECONDARY_BUS = 0x19;
 constexpr unsigned PCI_TYPE_BRIDGE   = 0x604;
 constexpr unsigned PCI_NONE          = 0xffff;
 
+constexpr uint16_t PCI_COMMAND_INTX_DISABLE = 1u << 10;
+constexpr uint16_t PCI_STATUS_CAPABILITIES  = 1u << 4;
+
+constexpr uint8_t  PCI_CAP_MSI       = 0x05;
+constexpr uint8_t  PCI_CAP_MSIX      = 0x11;
+
+// MSI capability: control, address low, [address high], data
+constexpr unsigned MSI_CONTROL       = 0x02;
+constexpr unsigned MSI_ADDRESS_LO    = 0x04;
+constexpr unsigned MSI_ADDRESS_HI    = 0x08;
+constexpr unsigned MSI_DATA_32       = 0x08;
+constexpr unsigned MSI_DATA_64       = 0x0c;
+constexpr uint16_t MSI_ENABLE        = 1u << 0;
+constexpr uint16_t MSI_MULTIPLE_MASK = 0x7u << 4;
+constexpr uint16_t MSI_64BIT         = 1u << 7;
+
+// MSI-X capability: control, table offset/BIR; the table lives in a BAR
+constexpr unsigned MSIX_CONTROL      = 0x02;
+constexpr unsigned MSIX_TABLE        = 0x04;
+constexpr uint16_t MSIX_TABLE_SIZE   = 0x7ff;
+constexpr uint16_t MSIX_MASK_ALL     = 1u << 14;
+constexpr uint16_t MSIX_ENABLE       = 1u << 15;
+constexpr uint32_t MSIX_BIR_MASK     = 0x7;
+constexpr uint32_t MSIX_ENTRY_MASKED = 1u << 0;
+
+constexpr uint32_t PCI_BAR_IO        = 0x1;
+constexpr uint32_t PCI_BAR_TYPE_MASK = 0x6;
+constexpr uint32_t PCI_BAR_64BIT     = 0x4;
+
+struct msix_entry
+{
+    uint32_t address_lo;
+    uint32_t address_hi;
+    uint32_t data;
+    uint32_t control;
+};
+
 
 // https://wiki.osdev.org/PCI
 // Two 32-bit IO locations used: (1) 0xcf8 (config data) and
@@ -179,4 +220,114 @@ namespace bus {
         return static_cast<uint16_t>((read_byte(addr, PCI_CLASS) << 8u)
                                     | read_byte(addr, PCI_SUBCLASS));
     }
+
+    // This function walks the capability list of a device looking for the given
+    // capability id, returning its offset in the configuration space.
+    uint8_t pci::find_capability(const pci_address_t &addr, uint8_t id) const
+    {
+        if ((read_word(addr, PCI_STATUS) & PCI_STATUS_CAPABILITIES) == 0) {
+            return 0;
+        }
+
+        // the list is at most 48 entries long (192 bytes after the header),
+        // bound the walk in case of a broken (circular) list
+        uint8_t offset = read_byte(addr, PCI_CAPABILITIES) & 0xfc;
+        for (int i = 0; offset != 0 && i < 48; i++) {
+            if (read_byte(addr, offset) == id) {
+                return offset;
+            }
+            offset = read_byte(addr, offset + 1) & 0xfc;
+        }
+
+        return 0;
+    }
+
+    // This function programs the MSI capability of a device with a single message
+    // targeting the given cpu and vector.
+    bool pci::enable_msi(const pci_address_t &addr, uint8_t vector, uint32_t cpu)
+    {
+        auto cap = find_capability(addr, PCI_CAP_MSI);
+        if (cap == 0) {
+            return false;
+        }
+
+        auto address = arch_->msi_address(cpu);
+        if (address == 0) {
+            return false;
+        }
+
+        auto control = read_word(addr, cap + MSI_CONTROL);
+
+        write_dword(addr, cap + MSI_ADDRESS_LO, static_cast<uint32_t>(address));
+        if (control & MSI_64BIT) {
+            write_dword(addr, cap + MSI_ADDRESS_HI, static_cast<uint32_t>(address >> 32));
+            write_word(addr, cap + MSI_DATA_64, static_cast<uint16_t>(arch_->msi_data(vector)));
+        }
+        else {
+            write_word(addr, cap + MSI_DATA_32, static_cast<uint16_t>(arch_->msi_data(vector)));
+        }
+
+        // a single message, no multiple message enable
+        control &= ~MSI_MULTIPLE_MASK;
+        write_word(addr, cap + MSI_CONTROL, control | MSI_ENABLE);
+        write_word(addr, PCI_COMMAND, read_word(addr, PCI_COMMAND) | PCI_COMMAND_INTX_DISABLE);
+
+        return true;
+    }
+
+    // This function programs one entry of the MSI-X table of a device, the table is
+    // located through the BAR and offset advertised by the capability.
+    bool pci::enable_msix(const pci_address_t &addr, uint16_t entry, uint8_t vector, uint32_t cpu)
+    {
+        auto cap = find_capability(addr, PCI_CAP_MSIX);
+        if (cap == 0) {
+            return false;
+        }
+
+        auto address = arch_->msi_address(cpu);
+        if (address == 0) {
+            return false;
+        }
+
+        auto control = read_word(addr, cap + MSIX_CONTROL);
+        uint16_t table_size = (control & MSIX_TABLE_SIZE) + 1;
+        if (entry >= table_size) {
+            return false;
+        }
+
+        auto table = read_dword(addr, cap + MSIX_TABLE);
+        auto bir = table & MSIX_BIR_MASK;
+        if (bir > 5) {
+            return false;
+        }
+
+        auto bar = read_dword(addr, PCI_BAR_0 + bir * 4);
+        if (bar & PCI_BAR_IO) {
+            return false;
+        }
+
+        uint64_t base = bar & ~0xfu;
+        if ((bar & PCI_BAR_TYPE_MASK) == PCI_BAR_64BIT && bir < 5) {
+            base |= static_cast<uint64_t>(read_dword(addr, PCI_BAR_0 + (bir + 1) * 4)) << 32;
+        }
+
+        auto *entries = static_cast<volatile msix_entry*>(
+            arch_->map_io(base + (table & ~MSIX_BIR_MASK), table_size * sizeof(msix_entry)));
+        if (entries == nullptr) {
+            return false;
+        }
+
+        // keep the whole function masked while the entry is half written
+        write_word(addr, cap + MSIX_CONTROL, control | MSIX_ENABLE | MSIX_MASK_ALL);
+
+        entries[entry].address_lo = static_cast<uint32_t>(address);
+        entries[entry].address_hi = static_cast<uint32_t>(address >> 32);
+        entries[entry].data = arch_->msi_data(vector);
+        entries[entry].control = entries[entry].control & ~MSIX_ENTRY_MASKED;
+
+        write_word(addr, cap + MSIX_CONTROL, (control | MSIX_ENABLE) & ~MSIX_MASK_ALL);
+        write_word(addr, PCI_COMMAND, read_word(addr, PCI_COMMAND) | PCI_COMMAND_INTX_DISABLE);
+
+        return true;
+    }
 }
\ No newline at end of file
@@ -56,6 +56,14 @@ namespace bus
         pci(iarch *arch) : arch_(arch) {}
         void scan_hardware();
 
+        // offset of the capability id in the config space, 0 if absent
+        uint8_t find_capability(const pci_address_t &addr, uint8_t id) const;
+
+        // message signaled interrupts delivering vector to cpu, legacy
+        // INTx is disabled once either is enabled. Both fail when cpu isn't online
+        bool enable_msi(const pci_address_t &addr, uint8_t vector, uint32_t cpu = 0);
+        bool enable_msix(const pci_address_t &addr, uint16_t entry, uint8_t vector, uint32_t cpu = 0);
+
     protected:
         uint8_t read_byte(const pci_address_t &addr, uint16_t field) const
         {
@@ -74,12 +82,12 @@ namespace bus
 
         void write_byte(const pci_address_t &addr, uint16_t field, uint8_t value) const
         {
-            arch_->write_byte(addr.get_address(field), PCI_ADDRESS_PORT, PCI_VALUE_PORT, value);
+            arch_->write_byte(addr.get_address(field), PCI_ADDRESS_PORT, PCI_VALUE_PORT + (field & 0x3), value);
         }
 
         void write_word(const pci_address_t &addr, uint16_t field, uint16_t value) const
         {
-            arch_->write_word(addr.get_address(field), PCI_ADDRESS_PORT, PCI_VALUE_PORT, value);
+            arch_->write_word(addr.get_address(field), PCI_ADDRESS_PORT, PCI_VALUE_PORT + (field & 0x2), value);
         }
 
         void write_dword(const pci_address_t &addr, uint16_t field, uint32_t value) const
@@ -1,6 +1,8 @@
 #include "keyboard.hpp"
 #include "arch/iarch.hpp"
 #include "libs/stdint.hpp"
+#include "arch/amd64/instructions.hpp"
+#include "task/task.hpp"
 
 constexpr uint16_t DATA_IN_BUFFER = 0x01;
 constexpr uint16_t STATUS_PORT = 0x64;
@@ -111,18 +113,81 @@ static const char en_US_shift[] = {
 #undef X
 };
 
-constexpr char SHIFT  = 0x1;
-constexpr char CTRL   = 0x2;
-constexpr char ALT    = 0x4;
-constexpr char CAPS   = 0x8;
-constexpr char NUM    = 0x10;
-constexpr char SCROLL = 0x20;
-constexpr char ESC    = 0x40;
+constexpr uint8_t EXTENDED_PREFIX = 0xe0;
+constexpr uint8_t BREAK_BIT       = 0x80;
 
-peripherals::keyboard::keyboard(iarch *arch) : arch_(arch), shift_(false)
+constexpr uint16_t SCANCODE_LEFT_SHIFT  = 0x2a;
+constexpr uint16_t SCANCODE_RIGHT_SHIFT = 0x36;
+constexpr uint16_t SCANCODE_CTRL        = 0x1d;
+constexpr uint16_t SCANCODE_ALT         = 0x38;
+constexpr uint16_t SCANCODE_CAPS        = 0x3a;
+
+peripherals::keyboard::keyboard(iarch *arch) : arch_(arch)
+{
+    tasklet::init(&tasklet_, &peripherals::keyboard::bottom_half, this);
+}
+
+char peripherals::keyboard::translate(uint8_t code) const
 {
+    if (code >= sizeof(en_US)) {
+        return 0;
+    }
+
+    char c = (modifiers_ & KEY_MOD_SHIFT) ? en_US_shift[code] : en_US[code];
+
+    // caps lock only affects letters, and shift undoes it
+    if (c >= 'a' && c <= 'z' && (modifiers_ & KEY_MOD_CAPS)) {
+        c = static_cast<char>(c - 'a' + 'A');
+    }
+    else if (c >= 'A' && c <= 'Z' && (modifiers_ & KEY_MOD_CAPS)) {
+        c = static_cast<char>(c - 'A' + 'a');
+    }
+
+    if ((modifiers_ & KEY_MOD_CTRL) && ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))) {
+        c = static_cast<char>(c & 0x1f);
+    }
+
+    return c;
 }
 
+void peripherals::keyboard::update_modifiers(uint16_t scancode, bool pressed)
+{
+    uint8_t modifier = 0;
+
+    // right ctrl/alt are the same codes behind the 0xe0 prefix
+    switch (scancode & ~KEY_EXTENDED) {
+        case SCANCODE_LEFT_SHIFT:
+        case SCANCODE_RIGHT_SHIFT:
+            // 0xe0 0x2a/0x36 are fake shifts around print screen
+            if ((scancode & KEY_EXTENDED) == 0) {
+                modifier = KEY_MOD_SHIFT;
+            }
+            break;
+
+        case SCANCODE_CTRL:
+            modifier = KEY_MOD_CTRL;
+            break;
+
+        case SCANCODE_ALT:
+            modifier = KEY_MOD_ALT;
+            break;
+
+        case SCANCODE_CAPS:
+            if (pressed) {
+                modifiers_ ^= KEY_MOD_CAPS;
+            }
+            return;
+    }
+
+    if (pressed) {
+        modifiers_ |= modifier;
+    }
+    else {
+        modifiers_ &= ~modifier;
+    }
+}
+
+// top half: take the byte out of the controller and defer the rest
 void peripherals::keyboard::on_keyboard(const interrupt_t &)
 {
     auto status = arch_->read_byte(STATUS_PORT);
@@ -130,43 +195,101 @@ void peripherals::keyboard::on_keyboard(const interrupt_t &)
         return;
     }
 
-    auto data = arch_->read_byte(DATA_PORT);
-
-    if (data & 0x80) {
-        on_keyup(data);
+    // the tasklet is SCANCODE_BUFFER bytes behind, lose the key
+    if (!scancodes_.push(arch_->read_byte(DATA_PORT))) {
+        __atomic_add_fetch(&dropped_, 1, __ATOMIC_RELAXED);
     }
-    else {
-        on_keydown(data);
+
+    tasklet::schedule(&tasklet_);
+}
+
+void peripherals::keyboard::bottom_half(void *data)
+{
+    auto *self = static_cast<peripherals::keyboard*>(data);
+
+    uint8_t scancode;
+    while (self->scancodes_.pop(scancode)) {
+        self->on_scancode(scancode);
     }
+
+    get_task_manager().wake(__atomic_load_n(&self->reader_, __ATOMIC_ACQUIRE));
 }
 
-void peripherals::keyboard::on_keyup(unsigned char c)
+// producer of events_: decode the byte and queue the event
+void peripherals::keyboard::on_scancode(uint8_t data)
 {
-    switch (c) {
-        case 0xaa: // left shift release
-        case 0xb6: // right shift release
-            shift_ = false;
-            return;
+    if (data == EXTENDED_PREFIX) {
+        extended_ = true;
+        return;
+    }
+
+    key_event event;
+    event.pressed = (data & BREAK_BIT) == 0;
+    event.scancode = data & ~BREAK_BIT;
+
+    if (extended_) {
+        event.scancode |= KEY_EXTENDED;
+        extended_ = false;
+    }
+
+    update_modifiers(event.scancode, event.pressed);
+
+    event.modifiers = modifiers_;
+    event.ascii = (event.scancode & KEY_EXTENDED) ? 0 : translate(static_cast<uint8_t>(event.scancode));
+
+    // nobody is reading, keep the oldest keys and count the rest
+    if (!events_.push(event)) {
+        __atomic_add_fetch(&dropped_, 1, __ATOMIC_RELAXED);
     }
 }
 
-void peripherals::keyboard::on_keydown(unsigned char c)
+size_t peripherals::keyboard::try_read(key_event *events, size_t count)
 {
-    switch (c) {
-        case 0x2a: // left shift
-        case 0x36: // right shift
-            shift_ = true;
-            return;
+    size_t total = 0;
+    while (total < count && events_.pop(events[total])) {
+        total++;
     }
 
-    if (shift_) {
-        arch_->get_video()->printc(en_US_shift[c]);
+    return total;
+}
+
+size_t peripherals::keyboard::read(key_event *events, size_t count)
+{
+    if (count == 0) {
+        return 0;
     }
-    else {
-        arch_->get_video()->printc(en_US[c]);
+
+    auto &tasks = get_task_manager();
+
+    while (true) {
+        auto total = try_read(events, count);
+        if (total > 0) {
+            return total;
+        }
+
+        // check again with interrupts off so the wake() can't slip
+        // between the empty test and block()
+        auto flags = insn::irq_save();
+        if (events_.empty()) {
+            if (tasks.current() == tasks.idle_task()) {
+                // the idle task can't park, just wait for the next irq
+                arch_->cpu_halt();
+            }
+            else {
+                __atomic_store_n(&reader_, tasks.current(), __ATOMIC_RELEASE);
+                tasks.block();
+                __atomic_store_n(&reader_, nullptr, __ATOMIC_RELEASE);
+            }
+        }
+        insn::irq_restore(flags);
     }
 }
 
+size_t peripherals::keyboard::dropped() const
+{
+    return __atomic_load_n(&dropped_, __ATOMIC_RELAXED);
+}
+
 peripherals::keyboard &peripherals::add_keyboard(iarch *arch)
 {
     static peripherals::keyboard instance(arch);
@@ -2,23 +2,73 @@
 #define KEYBOARD_HPP
 
 class iarch;
+struct task_t;
 
 #include "libs/functional.hpp"
+#include "libs/spsc_ring.hpp"
+#include "task/softirq.hpp"
 
 namespace peripherals
 {
+    constexpr uint8_t KEY_MOD_SHIFT = 0x1;
+    constexpr uint8_t KEY_MOD_CTRL  = 0x2;
+    constexpr uint8_t KEY_MOD_ALT   = 0x4;
+    constexpr uint8_t KEY_MOD_CAPS  = 0x8;
+
+    // scancodes that came after an 0xe0 prefix
+    constexpr uint16_t KEY_EXTENDED = 0xe000;
+
+    struct key_event
+    {
+        uint16_t scancode;  // make code, KEY_EXTENDED | code for 0xe0 keys
+        uint8_t  modifiers; // KEY_MOD_* held when the key changed
+        char     ascii;     // translated character, 0 when there is none
+        bool     pressed;   // false for release (break) events
+    };
+
+    /*
+     * PS/2 keyboard, scancode set 1
+     *
+     * The interrupt only takes the byte out of the controller and schedules
+     * a tasklet, which decodes the bytes into key_events and pushes them into
+     * a lock-free ring. A single reader task consumes the ring with read(),
+     * parking itself while the ring is empty and being woken by the tasklet.
+     */
     class keyboard
     {
     private:
+        static constexpr size_t SCANCODE_BUFFER = 64;
+        static constexpr size_t EVENT_BUFFER = 256;
+
         iarch *arch_;
-        bool shift_ = false;
+        uint8_t modifiers_ = 0;
+        bool extended_ = false;
+
+        // raw bytes from the interrupt, decoded by tasklet_
+        lib::spsc_ring<uint8_t, SCANCODE_BUFFER> scancodes_;
+        tasklet_t tasklet_;
+
+        lib::spsc_ring<key_event, EVENT_BUFFER> events_;
+        task_t *reader_ = nullptr;
+        size_t dropped_ = 0;
+
+        char translate(uint8_t code) const;
+        void update_modifiers(uint16_t scancode, bool pressed);
+
+        static void bottom_half(void *data);
+        void on_scancode(uint8_t data);
 
     public:
         keyboard(iarch *arch);
 
         void on_keyboard(const interrupt_t &interrupt);
-        void on_keyup(unsigned char c);
-        void on_keydown(unsigned char c);
+
+        // blocks until at least one event is available, returns how many
+        // were copied; try_read() returns 0 instead of blocking
+        size_t read(key_event *events, size_t count);
+        size_t try_read(key_event *events, size_t count);
+
+        size_t dropped() const;
     };
 
     keyboard &add_keyboard(iarch *arch);
@@ -0,0 +1,202 @@
+#include "serial.hpp"
+#include "arch/iarch.hpp"
+#include "arch/amd64/instructions.hpp"
+
+// register offsets from the base port
+constexpr uint16_t DATA          = 0; // THR/RBR, divisor low with DLAB
+constexpr uint16_t INT_ENABLE    = 1; // IER, divisor high with DLAB
+constexpr uint16_t INT_ID        = 2; // IIR on read, FCR on write
+constexpr uint16_t LINE_CONTROL  = 3;
+constexpr uint16_t MODEM_CONTROL = 4;
+constexpr uint16_t LINE_STATUS   = 5;
+constexpr uint16_t SCRATCH       = 7;
+
+constexpr uint8_t IER_THR_EMPTY  = 0x02;
+
+constexpr uint8_t IIR_NO_PENDING = 0x01;
+constexpr uint8_t IIR_ID_MASK    = 0x0e;
+constexpr uint8_t IIR_THR_EMPTY  = 0x02;
+
+constexpr uint8_t FCR_ENABLE     = 0x01;
+constexpr uint8_t FCR_CLEAR_RX   = 0x02;
+constexpr uint8_t FCR_CLEAR_TX   = 0x04;
+constexpr uint8_t FCR_TRIGGER_14 = 0xc0;
+
+constexpr uint8_t LCR_8N1        = 0x03;
+constexpr uint8_t LCR_DLAB       = 0x80;
+
+// OUT2 gates the UART interrupt line on PC compatibles
+constexpr uint8_t MCR_DTR        = 0x01;
+constexpr uint8_t MCR_RTS        = 0x02;
+constexpr uint8_t MCR_OUT2       = 0x08;
+
+constexpr uint8_t LSR_THR_EMPTY  = 0x20;
+constexpr uint8_t LSR_TX_EMPTY   = 0x40; // THR and shift register
+
+constexpr uint16_t DIVISOR_115200 = 1;
+constexpr size_t   FIFO_SIZE      = 16;
+
+constexpr uint8_t IRQ_COM1 = 4;
+
+peripherals::serial::serial(iarch *arch, uint16_t port) : iprotected_mode(), arch_(arch), port_(port)
+{
+}
+
+bool peripherals::serial::setup(uint8_t irq)
+{
+    // nothing answers on a missing UART, reads return 0xff
+    arch_->write_byte(port_ + SCRATCH, 0x5a);
+    if (arch_->read_byte(port_ + SCRATCH) != 0x5a) {
+        return false;
+    }
+
+    arch_->write_byte(port_ + INT_ENABLE, 0);
+
+    arch_->write_byte(port_ + LINE_CONTROL, LCR_DLAB);
+    arch_->write_byte(port_ + DATA, DIVISOR_115200 & 0xff);
+    arch_->write_byte(port_ + INT_ENABLE, DIVISOR_115200 >> 8);
+    arch_->write_byte(port_ + LINE_CONTROL, LCR_8N1);
+
+    arch_->write_byte(port_ + INT_ID, FCR_ENABLE | FCR_CLEAR_RX | FCR_CLEAR_TX | FCR_TRIGGER_14);
+    arch_->write_byte(port_ + MODEM_CONTROL, MCR_DTR | MCR_RTS | MCR_OUT2);
+
+    present_ = true;
+
+    if (arch_->register_interrupt(arch_->irq_vector(irq), &peripherals::serial::on_interrupt, this)) {
+        arch_->write_byte(port_ + INT_ENABLE, IER_THR_EMPTY);
+    }
+
+    return true;
+}
+
+bool peripherals::serial::present() const
+{
+    return present_;
+}
+
+size_t peripherals::serial::dropped() const
+{
+    return __atomic_load_n(&dropped_, __ATOMIC_RELAXED);
+}
+
+// moves up to a FIFO worth of bytes to the UART, callers have interrupts
+// disabled so the interrupt and the writers never drain at the same time
+void peripherals::serial::transmit()
+{
+    if ((arch_->read_byte(port_ + LINE_STATUS) & LSR_THR_EMPTY) == 0) {
+        // still sending, the THR-empty interrupt comes back for the rest
+        return;
+    }
+
+    char c;
+    for (size_t i = 0; i < FIFO_SIZE && tx_.pop(c); i++) {
+        arch_->write_byte(port_ + DATA, static_cast<uint8_t>(c));
+    }
+}
+
+void peripherals::serial::on_interrupt(const interrupt_t &, void *context)
+{
+    auto *self = static_cast<peripherals::serial*>(context);
+
+    while (true) {
+        auto id = self->arch_->read_byte(self->port_ + INT_ID);
+        if (id & IIR_NO_PENDING) {
+            return;
+        }
+
+        // reading IIR already cleared a THR-empty condition, anything else
+        // (line status, receive) isn't enabled
+        if ((id & IIR_ID_MASK) != IIR_THR_EMPTY) {
+            return;
+        }
+
+        self->transmit();
+    }
+}
+
+void peripherals::serial::push(char c)
+{
+    if (!tx_.push(c)) {
+        __atomic_fetch_add(&dropped_, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void peripherals::serial::clear()
+{
+    // ANSI: erase the screen, cursor home
+    prints("\033[2J\033[H");
+}
+
+void peripherals::serial::flush()
+{
+    if (!present_) {
+        return;
+    }
+
+    auto flags = insn::irq_save();
+    transmit();
+    insn::irq_restore(flags);
+}
+
+void peripherals::serial::drain()
+{
+    if (!present_) {
+        return;
+    }
+
+    // polls with interrupts off, the THR-empty interrupt may run in
+    // between when the caller has them on
+    while (!tx_.empty()) {
+        flush();
+        asm volatile("pause");
+    }
+
+    while ((arch_->read_byte(port_ + LINE_STATUS) & LSR_TX_EMPTY) == 0) {
+        asm volatile("pause");
+    }
+}
+
+void peripherals::serial::printc(char c)
+{
+    if (!present_) {
+        return;
+    }
+
+    // writers can be tasks and interrupt handlers, with interrupts off
+    // there is a single producer at a time
+    auto flags = insn::irq_save();
+    if (c == '\n') {
+        push('\r');
+    }
+    push(c);
+    transmit();
+    insn::irq_restore(flags);
+}
+
+void peripherals::serial::prints(const char *s)
+{
+    if (!present_) {
+        return;
+    }
+
+    auto flags = insn::irq_save();
+    for (; *s != '\0'; s++) {
+        if (*s == '\n') {
+            push('\r');
+        }
+        push(*s);
+    }
+    transmit();
+    insn::irq_restore(flags);
+}
+
+peripherals::serial *peripherals::add_serial(iarch *arch)
+{
+    static peripherals::serial instance(arch, COM1_PORT);
+
+    if (!instance.present() && !instance.setup(IRQ_COM1)) {
+        return nullptr;
+    }
+
+    return &instance;
+}
\ No newline at end of file
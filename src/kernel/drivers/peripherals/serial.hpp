@@ -0,0 +1,60 @@
+#ifndef SERIAL_HPP
+#define SERIAL_HPP
+
+class iarch;
+
+#include "arch/iprotected_mode.hpp"
+#include "libs/functional.hpp"
+#include "libs/spsc_ring.hpp"
+
+namespace peripherals
+{
+    constexpr uint16_t COM1_PORT = 0x3f8;
+
+    /*
+     * 16550 UART console
+     *
+     * Writers only append to a RAM ring, the bytes are moved to the UART by
+     * whoever finds the transmitter idle: the writer itself when the line
+     * status says THR is empty, otherwise the THR-empty interrupt, which
+     * refills all 16 FIFO bytes at once. Nothing spins on the line status
+     * register but drain(), a full ring drops output and counts it.
+     */
+    class serial : public iprotected_mode
+    {
+    private:
+        static constexpr size_t TX_BUFFER = 16384;
+
+        iarch *arch_;
+        uint16_t port_;
+        bool present_ = false;
+        size_t dropped_ = 0;
+
+        lib::spsc_ring<char, TX_BUFFER> tx_;
+
+        void push(char c);
+        void transmit();
+
+        static void on_interrupt(const interrupt_t &interrupt, void *context);
+
+    public:
+        serial(iarch *arch, uint16_t port);
+
+        bool setup(uint8_t irq);
+        bool present() const;
+        size_t dropped() const;
+
+        void clear() override;
+        void flush() override;
+        // spins until every queued byte left the UART, interrupts stay
+        // as the caller had them
+        void drain() override;
+        void printc(char c) override;
+        void prints(const char *s) override;
+    };
+
+    // COM1 at 115200 8N1, nullptr when there is no UART
+    serial *add_serial(iarch *arch);
+}
+
+#endif // SERIAL_HPP
\ No newline at end of file
@@ -1,6 +1,9 @@
 #include "timer.hpp"
 #include "arch/iarch.hpp"
 #include "arch/amd64/instructions.hpp"
+#include "libs/profiler.hpp"
+#include "memory/vdso_page.hpp"
+#include "task/softirq.hpp"
 
 enum PIT_CHANNEL {
     CHANNEL_0 = 0x40,
@@ -8,6 +11,13 @@ enum PIT_CHANNEL {
     CHANNEL_2 = 0x42
 };
 
+// channel selection bits of the command register
+enum PIT_SELECT {
+    SELECT_CHANNEL_0 = 0x00,
+    SELECT_CHANNEL_1 = 0x40,
+    SELECT_CHANNEL_2 = 0x80
+};
+
 enum PIT_ACCESS {
     LATCH  = 0x00, // Latch count value
     LOBYTE = 0x10, // Low byte
@@ -31,9 +41,39 @@ constexpr uint8_t PIT_BCD_MODE = 0x01;
 // PIT frequency (1.193182 MHz)
 constexpr uint32_t PIT_FREQUENCY = 1193182;
 
+// NMI status and control: bit 0 gates channel 2, bit 1 drives the
+// speaker, bit 5 reflects channel 2 output
+constexpr uint16_t PIT_GATE_PORT   = 0x61;
+constexpr uint8_t  PIT_GATE_2      = 0x01;
+constexpr uint8_t  PIT_SPEAKER     = 0x02;
+constexpr uint8_t  PIT_OUT_2       = 0x20;
+
+// TSC calibration window
+constexpr uint32_t CALIBRATION_MS  = 10;
+
+// longest sleep with the tick stopped, keeps the vDSO extrapolation short
+constexpr uint64_t MAX_IDLE_NS     = 1'000'000'000ull;
+
 peripherals::timer::timer(iarch *arch, uint32_t frequency)
-    : arch_(arch), frequency_(frequency), ticks_(0) {
+    : arch_(arch), frequency_(frequency), ticks_(0), tsc_hz_(0), tsc_base_(0),
+      local_(false), stopped_(false) {
+
+    tsc_hz_ = calibrate_tsc();
+    tsc_base_ = insn::rdtsc();
+    memory::vdso_calibrate(frequency_, tsc_hz_, tsc_base_);
+
+    // prefer the per-cpu timer, the PIT is the fallback when it's missing
+    // or the TSC couldn't be calibrated
+    if (tsc_hz_ != 0 && arch_->local_timer_setup(tsc_hz_)) {
+        local_ = true;
+        arch_->local_timer_periodic(frequency_);
+        return;
+    }
+
+    pit_periodic();
+}
 
+void peripherals::timer::pit_periodic() {
     // Calculate the desired frequncy
     auto div = PIT_FREQUENCY / frequency_;
 
@@ -45,16 +85,71 @@ peripherals::timer::timer(iarch *arch, uint32_t frequency)
     }
 
     // Send command: channel 0, access mode Lo/Hi, Mode 2 (rate gen.), binary mode
-    auto cmd = PIT_CHANNEL::CHANNEL_0 | PIT_ACCESS::LOHI | PIT_MODE::MODE_2 | PIT_BINARY_MODE;
-    arch->write_byte(PIT_COMMAND_REG, cmd);
+    uint8_t cmd = static_cast<uint8_t>(PIT_SELECT::SELECT_CHANNEL_0) |
+                  static_cast<uint8_t>(PIT_ACCESS::LOHI) |
+                  static_cast<uint8_t>(PIT_MODE::MODE_2) |
+                  PIT_BINARY_MODE;
+    arch_->write_byte(PIT_COMMAND_REG, cmd);
 
     // Send divisor (Lo first, then high byte)
-    arch->write_byte(PIT_CHANNEL::CHANNEL_0, div & 0xFF);
-    arch->write_byte(PIT_CHANNEL::CHANNEL_0, (div >> 8) & 0xFF);
+    arch_->write_byte(PIT_CHANNEL::CHANNEL_0, div & 0xFF);
+    arch_->write_byte(PIT_CHANNEL::CHANNEL_0, (div >> 8) & 0xFF);
 }
 
+// Counts TSC cycles while PIT channel 2 runs a one-shot countdown of
+// CALIBRATION_MS. Channel 2 is only wired to the speaker, so this doesn't
+// disturb the channel 0 tick.
+uint64_t peripherals::timer::calibrate_tsc() {
+    constexpr uint32_t count = PIT_FREQUENCY / (1000 / CALIBRATION_MS);
+
+    // gate channel 2 on, keep the speaker off
+    auto gate = arch_->read_byte(PIT_GATE_PORT);
+    arch_->write_byte(PIT_GATE_PORT, (gate & ~PIT_SPEAKER) | PIT_GATE_2);
+
+    // channel 2, Lo/Hi, mode 0 (interrupt on terminal count): OUT2 goes
+    // high once the count reaches zero
+    uint8_t cmd = static_cast<uint8_t>(PIT_SELECT::SELECT_CHANNEL_2) |
+                  static_cast<uint8_t>(PIT_ACCESS::LOHI) |
+                  static_cast<uint8_t>(PIT_MODE::MODE_0) |
+                  PIT_BINARY_MODE;
+    arch_->write_byte(PIT_COMMAND_REG, cmd);
+    arch_->write_byte(PIT_CHANNEL::CHANNEL_2, count & 0xFF);
+    arch_->write_byte(PIT_CHANNEL::CHANNEL_2, (count >> 8) & 0xFF);
+
+    auto start = insn::rdtsc();
+    while ((arch_->read_byte(PIT_GATE_PORT) & PIT_OUT_2) == 0) {
+        insn::pause();
+    }
+    auto end = insn::rdtsc();
+
+    arch_->write_byte(PIT_GATE_PORT, gate);
+
+    return (end - start) * (1000 / CALIBRATION_MS);
+}
+
+// top half: the sample needs the interrupted frame, the rest is deferred
 void peripherals::timer::on_timer(const interrupt_t &interrupt) {
-    ticks_++;
+    lib::profiler::record(interrupt, lib::profiler::source::TIMER);
+
+    // raises merge while the softirq is pending, without a TSC to derive
+    // the count from every interrupt has to be counted here
+    if (tsc_hz_ == 0) {
+        ticks_++;
+    }
+
+    softirq::raise(softirq::TIMER);
+}
+
+void peripherals::timer::tick() {
+    auto tsc = insn::rdtsc();
+
+    // derive the tick count from the TSC so periods spent without a tick
+    // (tickless idle) are accounted for
+    if (tsc_hz_ != 0) {
+        ticks_ = ((tsc - tsc_base_) * frequency_) / tsc_hz_;
+    }
+
+    memory::vdso_tick(ticks_, tsc);
 }
 
 uint32_t peripherals::timer::get_frequency() const {
@@ -65,10 +160,37 @@ uint64_t peripherals::timer::get_ticks() const {
     return ticks_;
 }
 
+uint64_t peripherals::timer::get_tsc_frequency() const {
+    return tsc_hz_;
+}
+
+uint64_t peripherals::timer::nanoseconds() const {
+    return vdso::read_ns(memory::vdso_data());
+}
+
+void peripherals::timer::stop_tick() {
+    if (!local_ || stopped_) {
+        return;
+    }
+
+    stopped_ = true;
+    arch_->local_timer_oneshot(MAX_IDLE_NS);
+}
+
+void peripherals::timer::restart_tick() {
+    if (!stopped_) {
+        return;
+    }
+
+    stopped_ = false;
+    arch_->local_timer_periodic(frequency_);
+}
+
 peripherals::timer &peripherals::add_timer(iarch *arch, uint32_t frequency) {
     static peripherals::timer instance(arch, frequency);
     static timer_handler_t handler(instance, &peripherals::timer::on_timer);
 
+    softirq::open(softirq::TIMER, [] { instance.tick(); });
     arch->set_timer_handler(&handler);
 
     return instance;
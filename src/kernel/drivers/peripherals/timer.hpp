@@ -14,14 +14,36 @@ namespace peripherals
         iarch *arch_;
         uint32_t frequency_;
         uint64_t ticks_;
+        uint64_t tsc_hz_;
+        uint64_t tsc_base_;
+
+        // ticking from the per-cpu timer instead of the PIT
+        bool local_;
+        // periodic tick stopped while the cpu is idle
+        bool stopped_;
+
+        uint64_t calibrate_tsc();
+        void pit_periodic();
 
     public:
         timer(iarch *arch, uint32_t frequency);
 
         void on_timer(const interrupt_t &interrupt);
 
+        // TIMER softirq: updates the tick count and the vDSO clock
+        void tick();
+
         uint32_t get_frequency() const;
         uint64_t get_ticks() const;
+        uint64_t get_tsc_frequency() const;
+
+        // nanoseconds since boot, TSC resolution
+        uint64_t nanoseconds() const;
+
+        // tickless idle: replace the periodic tick by a single one-shot
+        // while there's nothing to run, restart it once the cpu wakes up
+        void stop_tick();
+        void restart_tick();
     };
 
     timer &add_timer(iarch *arch, uint32_t frequency);
@@ -0,0 +1,110 @@
+#include "boot_profile.hpp"
+#include "vdso.hpp"
+
+#include "arch/iprotected_mode.hpp"
+
+constexpr size_t EARLY_MILESTONES = 4;
+
+// written by boot.S with paging off, lives in .data so clearing bss
+// doesn't wipe the first stamp
+extern uint64_t boot_tsc[EARLY_MILESTONES];
+
+static const char *early_names_[EARLY_MILESTONES] = {
+    "start32",
+    "clear_bss",
+    "page_tables",
+    "long_mode",
+};
+
+static const char *names_[lib::boot_profile::MAX_MILESTONES];
+static uint64_t stamps_[lib::boot_profile::MAX_MILESTONES];
+static size_t count_;
+
+static size_t milestones()
+{
+    return EARLY_MILESTONES + count_;
+}
+
+static const char *name_of(size_t index)
+{
+    return (index < EARLY_MILESTONES) ? early_names_[index] : names_[index - EARLY_MILESTONES];
+}
+
+static uint64_t stamp_of(size_t index)
+{
+    return (index < EARLY_MILESTONES) ? boot_tsc[index] : stamps_[index - EARLY_MILESTONES];
+}
+
+static uint64_t to_us(uint64_t cycles, uint64_t tsc_hz)
+{
+    // 1e6 * cycles fits 64 bits for hours of boot at any real TSC rate
+    return cycles * 1'000'000ull / tsc_hz;
+}
+
+void lib::boot_profile::mark(const char *name)
+{
+    auto now = vdso::read_tsc();
+
+    if (count_ == MAX_MILESTONES) {
+        return;
+    }
+
+    names_[count_] = name;
+    stamps_[count_] = now;
+    count_++;
+}
+
+void lib::boot_profile::report(iprotected_mode *out, uint64_t tsc_hz)
+{
+    if (out == nullptr) {
+        return;
+    }
+
+    auto total = stamp_of(milestones() - 1) - stamp_of(0);
+    if (total == 0) {
+        return;
+    }
+
+    out->prints("Boot profile\n");
+
+    if (tsc_hz == 0) {
+        // uncalibrated TSC, raw cycles are the best we have
+        for (size_t i = 1; i < milestones(); i++) {
+            out->format("  {:<16} {:>14} cycles\n", name_of(i), stamp_of(i) - stamp_of(i - 1));
+        }
+        return;
+    }
+
+    out->format("  {:<16} {:>10} {:>6}\n", "phase", "ms", "%");
+
+    for (size_t i = 1; i < milestones(); i++) {
+        auto cycles = stamp_of(i) - stamp_of(i - 1);
+        auto us = to_us(cycles, tsc_hz);
+        auto permille = cycles * 1000 / total;
+
+        out->format("  {:<16} {:>6}.{:03} {:>4}.{}\n", name_of(i),
+                    us / 1000, us % 1000, permille / 10, permille % 10);
+    }
+
+    auto us = to_us(total, tsc_hz);
+    out->format("  {:<16} {:>6}.{:03}\n", "total", us / 1000, us % 1000);
+}
+
+void lib::boot_profile::trace(iprotected_mode *out, uint64_t tsc_hz)
+{
+    if (out == nullptr || tsc_hz == 0) {
+        return;
+    }
+
+    out->prints("{\"traceEvents\":[\n");
+
+    for (size_t i = 1; i < milestones(); i++) {
+        auto start = to_us(stamp_of(i - 1) - stamp_of(0), tsc_hz);
+        auto duration = to_us(stamp_of(i) - stamp_of(i - 1), tsc_hz);
+
+        out->format("{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":{},\"dur\":{}}}{}\n",
+                    name_of(i), start, duration, (i + 1 < milestones()) ? "," : "");
+    }
+
+    out->prints("],\"displayTimeUnit\":\"ms\"}\n");
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef BOOT_PROFILE_HPP
+#define BOOT_PROFILE_HPP
+
+#include "stdint.hpp"
+
+class iprotected_mode;
+
+/*
+ * Boot phase timing
+ *
+ * Every milestone is a TSC stamp, a phase is the time between a milestone
+ * and the previous one and is named after the milestone that ends it.
+ * The first four are taken by boot.S before any C++ runs:
+ *
+ *   start32       first instruction after GRUB
+ *   clear_bss     bss zeroed
+ *   page_tables   identity and higher half page tables filled
+ *   long_mode     running at the higher half, right before kmain
+ *
+ * kmain adds the rest with mark():
+ *
+ *     memory::initialize_memory(bootinfo);
+ *     lib::boot_profile::mark("memory");
+ *
+ * report() prints one row per phase, trace() the same phases as a Chrome
+ * trace (chrome://tracing, ui.perfetto.dev): the JSON starts at the line
+ * holding {"traceEvents" and ends at the line holding ]}.
+ */
+namespace lib::boot_profile
+{
+    constexpr size_t MAX_MILESTONES = 32;
+
+    // names must be literals, only the pointer is kept
+    void mark(const char *name);
+
+    void report(iprotected_mode *out, uint64_t tsc_hz);
+    void trace(iprotected_mode *out, uint64_t tsc_hz);
+}
+
+#endif // BOOT_PROFILE_HPP
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef CMDLINE_HPP
+#define CMDLINE_HPP
+
+#include "stdint.hpp"
+
+/*
+ * Multiboot command line splitting
+ *
+ *     const char *s = cmdline;
+ *     lib::cmdline::option option;
+ *     while (lib::cmdline::next(s, option)) {
+ *         if (option.is("timer.hz")) ...
+ *     }
+ *
+ * Options are separated by spaces, "key=value" or a bare "key" (empty
+ * value). Nothing is copied, key and value point into the command line.
+ */
+namespace lib::cmdline
+{
+    struct option
+    {
+        const char *key;
+        size_t      key_length;
+        const char *value;
+        size_t      value_length;
+
+        // key equals the NUL terminated name, also used to match words
+        // inside a value by pointing key at them
+        bool is(const char *name) const
+        {
+            for (size_t i = 0; i < key_length; i++) {
+                if (name[i] != key[i]) {
+                    return false;
+                }
+            }
+
+            return name[key_length] == '\0';
+        }
+    };
+
+    inline bool next(const char *&s, option &out)
+    {
+        while (*s == ' ') {
+            s++;
+        }
+
+        if (*s == '\0') {
+            return false;
+        }
+
+        out.key = s;
+        while (*s != '\0' && *s != ' ' && *s != '=') {
+            s++;
+        }
+        out.key_length = static_cast<size_t>(s - out.key);
+
+        if (*s == '=') {
+            s++;
+        }
+
+        out.value = s;
+        while (*s != '\0' && *s != ' ') {
+            s++;
+        }
+        out.value_length = static_cast<size_t>(s - out.value);
+
+        return true;
+    }
+}
+
+#endif // CMDLINE_HPP
\ No newline at end of file
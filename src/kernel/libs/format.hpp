@@ -0,0 +1,392 @@
+#ifndef FORMAT_HPP
+#define FORMAT_HPP
+
+#include "stdint.hpp"
+#include "string.hpp"
+#include "type_traits.hpp"
+
+/*
+ * Allocation-free formatting
+ *
+ *     char buffer[64];
+ *     lib::format_to(buffer, sizeof(buffer), "{} pages at {:p}", count, addr);
+ *
+ * Replacement fields are {} or {:[[fill]align][0][width][type]}:
+ *     align   < left, > right, ^ center (numbers default to right)
+ *     0       pad numbers with zeros after the sign or 0x prefix
+ *     type    d decimal, x/X hex, b binary, p 0x prefixed hex, c char, s string
+ * {{ and }} are literal braces.
+ *
+ * The format string is parsed at compile time: a field without an argument,
+ * an argument without a field or a malformed spec don't build. Output that
+ * doesn't fit the buffer is truncated, the buffer is always NUL terminated.
+ * Floating point isn't supported, the kernel never touches the FPU.
+ */
+namespace lib
+{
+    struct format_spec
+    {
+        char    fill  = ' ';
+        char    align = '\0';
+        char    type  = '\0';
+        bool    zero  = false;
+        uint8_t width = 0;
+    };
+
+    class format_buffer
+    {
+        char  *buffer_;
+        size_t size_;
+        size_t length_ = 0;
+
+    public:
+        format_buffer(char *buffer, size_t size) : buffer_(buffer), size_(size) {}
+
+        void put(char c)
+        {
+            if (length_ + 1 < size_) {
+                buffer_[length_++] = c;
+            }
+        }
+
+        void put(const char *s, size_t count)
+        {
+            for (size_t i = 0; i < count; i++) {
+                put(s[i]);
+            }
+        }
+
+        void fill(char c, size_t count)
+        {
+            for (size_t i = 0; i < count; i++) {
+                put(c);
+            }
+        }
+
+        size_t length() const
+        {
+            return length_;
+        }
+
+        const char *c_str()
+        {
+            if (size_ > 0) {
+                buffer_[length_] = '\0';
+            }
+            return buffer_;
+        }
+    };
+
+    // parses the spec right after '{', returns the index of the closing
+    // brace or 0 when the spec is malformed
+    constexpr size_t parse_format_spec(const char *s, size_t i, format_spec &spec)
+    {
+        auto is_align = [](char c) { return c == '<' || c == '>' || c == '^'; };
+
+        if (s[i] == '}') {
+            return i;
+        }
+
+        if (s[i] != ':') {
+            return 0;
+        }
+        i++;
+
+        if (s[i] != '\0' && s[i] != '}' && is_align(s[i + 1])) {
+            spec.fill = s[i];
+            spec.align = s[i + 1];
+            i += 2;
+        }
+        else if (is_align(s[i])) {
+            spec.align = s[i];
+            i++;
+        }
+
+        if (s[i] == '0') {
+            spec.zero = true;
+            i++;
+        }
+
+        size_t width = 0;
+        while (s[i] >= '0' && s[i] <= '9') {
+            width = width * 10 + (s[i] - '0');
+            i++;
+        }
+        spec.width = (width > 0xff) ? 0xff : static_cast<uint8_t>(width);
+
+        switch (s[i]) {
+            case 'd': case 'x': case 'X': case 'b':
+            case 'p': case 'c': case 's':
+                spec.type = s[i];
+                i++;
+                break;
+        }
+
+        return (s[i] == '}') ? i : 0;
+    }
+
+    struct format_field
+    {
+        uint16_t    begin = 0;  // the opening brace
+        uint16_t    end = 0;    // right after the closing brace
+        format_spec spec;
+    };
+
+    // not constexpr on purpose: reaching it during constant evaluation
+    // turns a bad format string into a compile error
+    void format_error(const char *reason);
+
+    template <typename... Args>
+    struct basic_format_string
+    {
+        const char  *str;
+        size_t       length;
+        format_field fields[sizeof...(Args) == 0 ? 1 : sizeof...(Args)];
+
+        template <size_t N>
+        consteval basic_format_string(const char (&s)[N]) : str(s), length(N - 1), fields{}
+        {
+            size_t count = 0;
+
+            for (size_t i = 0; i < length; i++) {
+                if ((s[i] == '{' && s[i + 1] == '{') || (s[i] == '}' && s[i + 1] == '}')) {
+                    i++;
+                    continue;
+                }
+
+                if (s[i] == '}') {
+                    format_error("unmatched '}' in format string");
+                }
+
+                if (s[i] != '{') {
+                    continue;
+                }
+
+                if (count == sizeof...(Args)) {
+                    format_error("more replacement fields than arguments");
+                }
+
+                auto &field = fields[count++];
+                field.begin = static_cast<uint16_t>(i);
+
+                i = parse_format_spec(s, i + 1, field.spec);
+                if (i == 0) {
+                    format_error("malformed replacement field");
+                }
+                field.end = static_cast<uint16_t>(i + 1);
+            }
+
+            if (count != sizeof...(Args)) {
+                format_error("more arguments than replacement fields");
+            }
+        }
+    };
+
+    template <typename... Args>
+    using format_string = basic_format_string<type_identity_t<Args>...>;
+
+    // pairs of decimal digits, two digits per division by 100
+    inline constexpr char DIGIT_PAIRS[] =
+        "0001020304050607080910111213141516171819"
+        "2021222324252627282930313233343536373839"
+        "4041424344454647484950515253545556575859"
+        "6061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    // the writers fill the buffer backwards from end, return the first digit
+    inline char *format_decimal(char *end, uint64_t value)
+    {
+        while (value >= 100) {
+            auto pair = (value % 100) * 2;
+            value /= 100;
+            *--end = DIGIT_PAIRS[pair + 1];
+            *--end = DIGIT_PAIRS[pair];
+        }
+
+        if (value >= 10) {
+            *--end = DIGIT_PAIRS[value * 2 + 1];
+            *--end = DIGIT_PAIRS[value * 2];
+        }
+        else {
+            *--end = static_cast<char>('0' + value);
+        }
+
+        return end;
+    }
+
+    inline char *format_radix(char *end, uint64_t value, unsigned shift, bool upper)
+    {
+        const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+        uint64_t mask = (1ull << shift) - 1;
+
+        do {
+            *--end = digits[value & mask];
+            value >>= shift;
+        } while (value != 0);
+
+        return end;
+    }
+
+    // prefix is the sign or 0x part, zero padding goes right after it
+    inline void format_padded(format_buffer &out, const format_spec &spec, const char *text,
+                              size_t length, char default_align, size_t prefix = 0)
+    {
+        size_t pad = (spec.width > length) ? spec.width - length : 0;
+
+        if (spec.zero && default_align == '>') {
+            out.put(text, prefix);
+            out.fill('0', pad);
+            out.put(text + prefix, length - prefix);
+            return;
+        }
+
+        char align = (spec.align != '\0') ? spec.align : default_align;
+        size_t before = (align == '>') ? pad : (align == '^') ? pad / 2 : 0;
+
+        out.fill(spec.fill, before);
+        out.put(text, length);
+        out.fill(spec.fill, pad - before);
+    }
+
+    inline void format_integer(format_buffer &out, const format_spec &spec, uint64_t magnitude, bool negative)
+    {
+        // 64 binary digits, a sign and a 0x prefix
+        char text[68];
+        char *end = text + sizeof(text);
+        char *first;
+        size_t prefix = 0;
+
+        switch (spec.type) {
+            case 'x':
+                first = format_radix(end, magnitude, 4, false);
+                break;
+
+            case 'X':
+                first = format_radix(end, magnitude, 4, true);
+                break;
+
+            case 'b':
+                first = format_radix(end, magnitude, 1, false);
+                break;
+
+            case 'p':
+                first = format_radix(end, magnitude, 4, false);
+                *--first = 'x';
+                *--first = '0';
+                prefix = 2;
+                break;
+
+            default:
+                first = format_decimal(end, magnitude);
+                break;
+        }
+
+        if (negative) {
+            *--first = '-';
+            prefix++;
+        }
+
+        format_padded(out, spec, first, end - first, '>', prefix);
+    }
+
+    inline void format_value(format_buffer &out, const format_spec &spec, const char *value)
+    {
+        if (spec.type == 'p') {
+            format_integer(out, spec, ptr_from(value), false);
+            return;
+        }
+
+        if (value == nullptr) {
+            value = "(null)";
+        }
+        format_padded(out, spec, value, strlen(value), '<');
+    }
+
+    template <typename T>
+    inline void format_value(format_buffer &out, const format_spec &spec, T *value)
+    {
+        if constexpr (is_same_v<T, char>) {
+            format_value(out, spec, static_cast<const char*>(value));
+        }
+        else {
+            format_spec pointer = spec;
+            pointer.type = 'p';
+            format_integer(out, pointer, ptr_from(value), false);
+        }
+    }
+
+    template <typename T>
+    inline void format_value(format_buffer &out, const format_spec &spec, T value)
+    {
+        static_assert(!is_floating_point_v<T>, "floating point can't be formatted in the kernel");
+
+        if constexpr (is_same_v<T, bool>) {
+            const char *text = value ? "true" : "false";
+            format_padded(out, spec, text, strlen(text), '<');
+        }
+        else if constexpr (is_same_v<T, char>) {
+            if (spec.type == '\0' || spec.type == 'c') {
+                format_padded(out, spec, &value, 1, '<');
+            }
+            else {
+                format_integer(out, spec, static_cast<uint8_t>(value), false);
+            }
+        }
+        else if constexpr (is_integral_v<T>) {
+            if constexpr (static_cast<T>(-1) < static_cast<T>(0)) {
+                // negate in unsigned arithmetic, INT64_MIN has no positive
+                uint64_t magnitude = static_cast<uint64_t>(value);
+                format_integer(out, spec, value < 0 ? 0 - magnitude : magnitude, value < 0);
+            }
+            else {
+                format_integer(out, spec, static_cast<uint64_t>(value), false);
+            }
+        }
+        else if constexpr (__is_enum(T)) {
+            format_value(out, spec, static_cast<int64_t>(value));
+        }
+        else {
+            static_assert(is_integral_v<T>, "type can't be formatted");
+        }
+    }
+
+    // copies format text between fields, dropping the escape of {{ and }}
+    inline void format_literal(format_buffer &out, const char *s, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++) {
+            out.put(s[i]);
+            if ((s[i] == '{' || s[i] == '}') && i + 1 < end && s[i + 1] == s[i]) {
+                i++;
+            }
+        }
+    }
+
+    template <typename... Args>
+    inline void format_into(format_buffer &out, format_string<Args...> fmt, Args... args)
+    {
+        [[maybe_unused]] size_t index = 0;
+        size_t position = 0;
+
+        ([&] {
+            const auto &field = fmt.fields[index++];
+            format_literal(out, fmt.str, position, field.begin);
+            format_value(out, field.spec, args);
+            position = field.end;
+        }(), ...);
+
+        format_literal(out, fmt.str, position, fmt.length);
+    }
+
+    // returns the formatted length, excluding the terminator
+    template <typename... Args>
+    inline size_t format_to(char *buffer, size_t size, format_string<Args...> fmt, Args... args)
+    {
+        format_buffer out(buffer, size);
+        format_into<Args...>(out, fmt, args...);
+        out.c_str();
+
+        return out.length();
+    }
+}
+
+#endif // FORMAT_HPP
\ No newline at end of file
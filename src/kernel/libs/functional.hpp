@@ -21,6 +21,16 @@ namespace lib
             (instance.*method)(interrupt);
         }
     };
+
+    // entry of a vector's handler chain, context is handed back untouched
+    using interrupt_callback_t = void (*)(const interrupt_t &interrupt, void *context);
+
+    // adapts any callable object passed as context to interrupt_callback_t
+    template <typename T>
+    void interrupt_trampoline(const interrupt_t &interrupt, void *context)
+    {
+        (*static_cast<const T*>(context))(interrupt);
+    }
 }
 
 #endif // FUNCTIONAL_HPP
\ No newline at end of file
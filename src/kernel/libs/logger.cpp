@@ -0,0 +1,153 @@
+#include "logger.hpp"
+#include "format.hpp"
+#include "spsc_ring.hpp"
+
+#include "config.hpp"
+#include "arch/iprotected_mode.hpp"
+#include "arch/amd64/instructions.hpp"
+#include "arch/amd64/percpu.hpp"
+#include "memory/vdso_page.hpp"
+#include "task/workqueue.hpp"
+
+constexpr size_t RECORDS_PER_CPU = 128;
+constexpr size_t MAX_SINKS       = 4;
+constexpr size_t LINE_SIZE       = 192;
+
+struct log_sink
+{
+    iprotected_mode *device;
+    lib::log_level   min_level;
+};
+
+static lib::spsc_ring<lib::log_record, RECORDS_PER_CPU> rings_[MAX_CPUS];
+static log_sink sinks_[MAX_SINKS];
+static size_t sink_count_;
+static size_t dropped_;
+
+static void drain_work(work_t *)
+{
+    lib::logger::drain();
+}
+
+// queued by every submit, the queue runs it once however many piled up
+static work_t drain_work_ = { nullptr, drain_work, false };
+
+static const char level_names[] = { 'T', 'I', 'W', 'E', 'C' };
+
+static void format_argument(lib::format_buffer &line, const lib::format_spec &spec,
+                            const lib::log_record &record, size_t index)
+{
+    auto value = record.args[index];
+
+    switch (record.kinds[index]) {
+        case lib::log_arg::STRING:
+            lib::format_value(line, spec, ptr_to<const char*>(value));
+            break;
+
+        case lib::log_arg::SIGNED:
+            lib::format_value(line, spec, static_cast<int64_t>(value));
+            break;
+
+        case lib::log_arg::UNSIGNED:
+            lib::format_value(line, spec, value);
+            break;
+
+        case lib::log_arg::POINTER:
+            lib::format_value(line, spec, ptr_to<const void*>(value));
+            break;
+    }
+}
+
+static const char *format(lib::format_buffer &line, const lib::log_record &record)
+{
+    // the format string is only known at run time here, fields are parsed
+    // with the same rules lib::format_to checks at compile time
+    uint64_t hz = memory::vdso_data()->tsc_hz;
+    if (hz == 0) {
+        // not calibrated yet, raw cycles
+        lib::format_into(line, "[{}] ", record.timestamp);
+    }
+    else {
+        lib::format_into(line, "[{:>5}.{:06}] ", record.timestamp / hz, (record.timestamp % hz) * 1'000'000 / hz);
+    }
+    lib::format_into(line, "{} ", level_names[static_cast<uint8_t>(record.level)]);
+
+    const char *fmt = record.format;
+    size_t index = 0;
+
+    for (size_t i = 0; fmt[i] != '\0'; i++) {
+        if ((fmt[i] == '{' || fmt[i] == '}') && fmt[i + 1] == fmt[i]) {
+            line.put(fmt[i++]);
+            continue;
+        }
+
+        lib::format_spec spec;
+        size_t close = (fmt[i] == '{') ? lib::parse_format_spec(fmt, i + 1, spec) : 0;
+        if (close == 0) {
+            line.put(fmt[i]);
+            continue;
+        }
+
+        if (index < record.count) {
+            format_argument(line, spec, record, index++);
+        }
+        i = close;
+    }
+
+    line.put('\n');
+    return line.c_str();
+}
+
+void lib::logger::submit(const log_record &record)
+{
+    // interrupt handlers log too, with interrupts off this cpu's ring has
+    // a single producer
+    auto flags = insn::irq_save();
+    if (!rings_[percpu::id()].push(record)) {
+        dropped_++;
+    }
+    insn::irq_restore(flags);
+
+    workqueue::queue(&drain_work_);
+}
+
+bool lib::logger::add_sink(iprotected_mode *sink, log_level min_level)
+{
+    if (sink == nullptr || sink_count_ == MAX_SINKS) {
+        return false;
+    }
+
+    sinks_[sink_count_++] = { sink, min_level };
+    return true;
+}
+
+size_t lib::logger::dropped()
+{
+    return dropped_;
+}
+
+void lib::logger::drain()
+{
+    log_record record;
+
+    // the drainer is the only consumer, rings are read cpu by cpu and each
+    // line carries its timestamp
+    for (size_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        while (rings_[cpu].pop(record)) {
+            char buffer[LINE_SIZE];
+            lib::format_buffer line(buffer, sizeof(buffer));
+            const char *text = nullptr;
+
+            for (size_t i = 0; i < sink_count_; i++) {
+                if (record.level < sinks_[i].min_level) {
+                    continue;
+                }
+
+                if (text == nullptr) {
+                    text = format(line, record);
+                }
+                sinks_[i].device->prints(text);
+            }
+        }
+    }
+}
\ No newline at end of file
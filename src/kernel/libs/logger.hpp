@@ -1,6 +1,32 @@
 #ifndef LOGGER_HPP
 #define LOGGER_HPP
 
+#include "stdint.hpp"
+#include "type_traits.hpp"
+#include "vdso.hpp"
+
+class iprotected_mode;
+
+/*
+ * Binary trace logger
+ *
+ * log() doesn't format anything: it stores the TSC, the level, the format
+ * string pointer and up to LOG_MAX_ARGS raw arguments into a ring owned by
+ * the current cpu and returns. A work item (see task/workqueue.hpp) drains
+ * the rings later, formats each record and hands the line to every sink
+ * whose level allows it (the serial port, the console for errors).
+ *
+ *     lib::log(lib::log_level::INFO, "mapped {} pages at {:x}", count, addr);
+ *
+ * Fields follow libs/format.hpp ({}, {:x}, {:>8}...) but are parsed when
+ * the record is drained. Strings are stored by pointer, pass literals or
+ * anything that outlives the drain.
+ * Levels below LOG_LEVEL are discarded at compile time.
+ */
+#ifndef LOG_LEVEL
+#define LOG_LEVEL 1
+#endif
+
 namespace lib
 {
     enum class log_level : uint8_t
@@ -12,10 +38,80 @@ namespace lib
         CRITICAL
     };
 
-    inline void log(log_level level, const char *message)
+    constexpr log_level LOG_MIN_LEVEL = static_cast<log_level>(LOG_LEVEL);
+    constexpr size_t LOG_MAX_ARGS = 4;
+
+    enum class log_arg : uint8_t
+    {
+        SIGNED,
+        UNSIGNED,
+        POINTER,
+        STRING
+    };
+
+    struct log_record
     {
-        (void)level;
-        (void)message;
+        uint64_t    timestamp;
+        const char *format;
+        uint64_t    args[LOG_MAX_ARGS];
+        log_level   level;
+        uint8_t     count;
+        log_arg     kinds[LOG_MAX_ARGS];
+    };
+
+    namespace logger
+    {
+        // copies the record into this cpu's ring, drops it when full
+        void submit(const log_record &record);
+
+        bool add_sink(iprotected_mode *sink, log_level min_level);
+
+        // formats every pending record now, from the caller's context
+        void drain();
+
+        size_t dropped();
+    }
+
+    inline void log_store(log_record &record, size_t index, const char *value)
+    {
+        record.kinds[index] = log_arg::STRING;
+        record.args[index] = ptr_from(value);
+    }
+
+    template <typename T>
+    inline void log_store(log_record &record, size_t index, T *value)
+    {
+        record.kinds[index] = is_same_v<T, char> ? log_arg::STRING : log_arg::POINTER;
+        record.args[index] = ptr_from(value);
+    }
+
+    // integers and enums
+    template <typename T>
+    inline void log_store(log_record &record, size_t index, T value)
+    {
+        record.kinds[index] = (static_cast<T>(-1) < static_cast<T>(0)) ? log_arg::SIGNED : log_arg::UNSIGNED;
+        record.args[index] = static_cast<uint64_t>(value);
+    }
+
+    template <typename... Args>
+    inline void log(log_level level, const char *format, Args... args)
+    {
+        static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+
+        if (level < LOG_MIN_LEVEL) {
+            return;
+        }
+
+        log_record record;
+        record.timestamp = vdso::read_tsc();
+        record.format = format;
+        record.level = level;
+        record.count = sizeof...(Args);
+
+        [[maybe_unused]] size_t index = 0;
+        (log_store(record, index++, args), ...);
+
+        logger::submit(record);
     }
 }
 
@@ -0,0 +1,152 @@
+#include "profiler.hpp"
+#include "format.hpp"
+
+#include "config.hpp"
+#include "arch/iprotected_mode.hpp"
+#include "arch/amd64/percpu.hpp"
+#include "arch/amd64/registers.hpp"
+
+// the longest kernel stack (the boot stack), a frame pointer further
+// than that from the interrupted RSP isn't a frame of this stack
+constexpr uintptr_t MAX_STACK_SPAN = KSTACK_SIZE;
+
+// lines between drains, keeps a serial console's ring from overflowing
+constexpr size_t LINES_PER_DRAIN = 64;
+
+struct cpu_samples
+{
+    lib::profiler::sample samples[lib::profiler::SAMPLES_PER_CPU];
+    size_t count;
+};
+
+extern uint64_t _start;
+extern uint64_t _etext;
+
+static cpu_samples cpus_[MAX_CPUS];
+static bool running_;
+static lib::profiler::source source_;
+static size_t dropped_;
+
+static bool is_kernel_text(uint64_t addr)
+{
+    return addr >= ptr_from(&_start) && addr < ptr_from(&_etext);
+}
+
+// every frame starts with the caller's RBP and the return address, each
+// step must move up the same stack and land back in kernel code
+static size_t walk(uint64_t rbp, uint64_t rsp, uint64_t *callers)
+{
+    size_t depth = 0;
+    uint64_t low = rsp;
+
+    while (depth < lib::profiler::MAX_DEPTH) {
+        if (rbp < low || rbp - rsp >= MAX_STACK_SPAN || (rbp & 0x7) != 0) {
+            break;
+        }
+
+        auto *frame = ptr_to<const uint64_t*>(rbp);
+        auto ret = frame[1];
+        if (!is_kernel_text(ret)) {
+            break;
+        }
+
+        callers[depth++] = ret;
+        low = rbp + 2 * sizeof(uint64_t);
+        rbp = frame[0];
+    }
+
+    return depth;
+}
+
+void lib::profiler::start(source from)
+{
+    source_ = from;
+    __atomic_store_n(&running_, true, __ATOMIC_RELEASE);
+}
+
+void lib::profiler::stop()
+{
+    __atomic_store_n(&running_, false, __ATOMIC_RELEASE);
+}
+
+bool lib::profiler::running()
+{
+    return __atomic_load_n(&running_, __ATOMIC_ACQUIRE);
+}
+
+void lib::profiler::record(const interrupt_t &interrupt, source from)
+{
+    if (!running() || from != source_) {
+        return;
+    }
+
+    auto &cpu = cpus_[percpu::id()];
+    if (cpu.count == SAMPLES_PER_CPU) {
+        __atomic_fetch_add(&dropped_, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    auto &sample = cpu.samples[cpu.count];
+    sample.rip = interrupt.rip;
+
+    size_t depth = 0;
+    if ((interrupt.cs & 0x3) == 0) {
+        // same privilege: userrsp is the interrupted kernel RSP
+        depth = walk(interrupt.registers.rbp, interrupt.userrsp, sample.callers);
+    }
+
+    for (; depth < MAX_DEPTH; depth++) {
+        sample.callers[depth] = 0;
+    }
+
+    // publish the sample to dump()
+    __atomic_store_n(&cpu.count, cpu.count + 1, __ATOMIC_RELEASE);
+}
+
+void lib::profiler::dump(iprotected_mode *out)
+{
+    stop();
+
+    if (out == nullptr) {
+        return;
+    }
+
+    lib::format_spec hex;
+    hex.type = 'x';
+
+    for (auto &cpu : cpus_) {
+        auto count = __atomic_load_n(&cpu.count, __ATOMIC_ACQUIRE);
+
+        for (size_t i = 0; i < count; i++) {
+            const auto &sample = cpu.samples[i];
+
+            char buffer[PRINT_BUFFER];
+            lib::format_buffer line(buffer, sizeof(buffer));
+
+            line.put("sample ", 7);
+            lib::format_value(line, hex, sample.rip);
+
+            for (size_t depth = 0; depth < MAX_DEPTH && sample.callers[depth] != 0; depth++) {
+                line.put(' ');
+                lib::format_value(line, hex, sample.callers[depth]);
+            }
+
+            line.put('\n');
+            out->prints(line.c_str());
+
+            if ((i + 1) % LINES_PER_DRAIN == 0) {
+                out->drain();
+            }
+        }
+
+        __atomic_store_n(&cpu.count, 0, __ATOMIC_RELEASE);
+    }
+
+    out->format("profile dropped={}\n", dropped());
+    __atomic_store_n(&dropped_, 0, __ATOMIC_RELAXED);
+}
+
+size_t lib::profiler::dropped()
+{
+    return __atomic_load_n(&dropped_, __ATOMIC_RELAXED);
+}
\ No newline at end of file
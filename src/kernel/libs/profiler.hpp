@@ -0,0 +1,57 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include "stdint.hpp"
+
+class iprotected_mode;
+struct interrupt_t;
+
+/*
+ * Sampling profiler
+ *
+ * While running, every sample interrupt stores the interrupted RIP and up
+ * to MAX_DEPTH return addresses found by walking the frame pointer chain
+ * into a buffer owned by the current cpu. A full buffer drops samples
+ * until the next dump(). Samples come from the timer tick or, with
+ * pmu::start_sampling(), from a performance counter overflow, start()
+ * picks which one is recorded.
+ *
+ * dump() prints one line per sample, hex addresses innermost first:
+ *
+ *     sample ffffffff80104a2c ffffffff80104b90 ffffffff801021f3
+ *
+ * tools/profile/symbolize.py resolves them against coronel.sym and folds
+ * them into stacks for flamegraph.pl or speedscope. The stack walk
+ * depends on -fno-omit-frame-pointer, user mode samples keep the RIP only.
+ */
+namespace lib::profiler
+{
+    constexpr size_t SAMPLES_PER_CPU = 1024;
+    constexpr size_t MAX_DEPTH       = 7;
+
+    struct sample
+    {
+        uint64_t rip;
+        uint64_t callers[MAX_DEPTH];    // 0 terminated when shorter
+    };
+
+    enum class source : uint8_t
+    {
+        TIMER,
+        PMU
+    };
+
+    void start(source from = source::TIMER);
+    void stop();
+    bool running();
+
+    // interrupt context, samples of the other source are ignored
+    void record(const interrupt_t &interrupt, source from);
+
+    // stops sampling, prints and discards every sample
+    void dump(iprotected_mode *out);
+
+    size_t dropped();
+}
+
+#endif // PROFILER_HPP
\ No newline at end of file
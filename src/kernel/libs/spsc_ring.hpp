@@ -0,0 +1,69 @@
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include "stdint.hpp"
+
+namespace lib
+{
+    /*
+     * Lock-free single-producer/single-consumer ring
+     *
+     * The producer only writes head_, the consumer only writes tail_, so
+     * the two sides never need a lock: an interrupt handler can push while
+     * a task pops. Both indexes run freely and wrap through the mask, so
+     * all N slots are usable. N must be a power of two.
+     */
+    template <typename T, size_t N>
+    class spsc_ring
+    {
+        static_assert(N != 0 && (N & (N - 1)) == 0, "spsc_ring size must be a power of two");
+
+        T items_[N];
+        size_t head_ = 0;
+        size_t tail_ = 0;
+
+    public:
+        // producer side, false when full
+        bool push(const T &item)
+        {
+            auto head = __atomic_load_n(&head_, __ATOMIC_RELAXED);
+            if (head - __atomic_load_n(&tail_, __ATOMIC_ACQUIRE) == N) {
+                return false;
+            }
+
+            items_[head & (N - 1)] = item;
+            __atomic_store_n(&head_, head + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+
+        // consumer side, false when empty
+        bool pop(T &item)
+        {
+            auto tail = __atomic_load_n(&tail_, __ATOMIC_RELAXED);
+            if (tail == __atomic_load_n(&head_, __ATOMIC_ACQUIRE)) {
+                return false;
+            }
+
+            item = items_[tail & (N - 1)];
+            __atomic_store_n(&tail_, tail + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+
+        bool empty() const
+        {
+            return __atomic_load_n(&head_, __ATOMIC_ACQUIRE) == __atomic_load_n(&tail_, __ATOMIC_ACQUIRE);
+        }
+
+        size_t size() const
+        {
+            return __atomic_load_n(&head_, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail_, __ATOMIC_ACQUIRE);
+        }
+
+        constexpr size_t capacity() const
+        {
+            return N;
+        }
+    };
+}
+
+#endif // SPSC_RING_HPP
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "static_key.hpp"
+#include "cmdline.hpp"
+#include "logger.hpp"
+
+#include "arch/amd64/instructions.hpp"
+
+constexpr size_t  PATCH_SIZE = 5;
+constexpr uint8_t JMP_REL32  = 0xe9;
+
+static constexpr uint8_t NOP5[PATCH_SIZE] = { 0x0f, 0x1f, 0x44, 0x00, 0x00 };
+
+// bounds of the __jump_table section, see coronel.ld
+extern lib::jump_entry __jump_table_start[];
+extern lib::jump_entry __jump_table_end[];
+
+static void patch(const lib::jump_entry &entry, bool enabled)
+{
+    auto *code = ptr_to<uint8_t*>(entry.code);
+
+    if (!enabled) {
+        for (size_t i = 0; i < PATCH_SIZE; i++) {
+            code[i] = NOP5[i];
+        }
+        return;
+    }
+
+    // both ends are in the kernel image, the distance fits a rel32
+    auto rel = static_cast<int32_t>(entry.target - (entry.code + PATCH_SIZE));
+    auto *bytes = reinterpret_cast<const uint8_t*>(&rel);
+
+    code[0] = JMP_REL32;
+    for (size_t i = 0; i < sizeof(rel); i++) {
+        code[1 + i] = bytes[i];
+    }
+}
+
+static void update(lib::static_key &key, bool enabled)
+{
+    auto flags = insn::irq_save();
+
+    if (key.enabled != enabled) {
+        for (auto *entry = __jump_table_start; entry < __jump_table_end; entry++) {
+            if (entry->key == &key) {
+                patch(*entry, enabled);
+            }
+        }
+        key.enabled = enabled;
+    }
+
+    insn::irq_restore(flags);
+}
+
+void lib::static_keys::enable(static_key &key)
+{
+    update(key, true);
+}
+
+void lib::static_keys::disable(static_key &key)
+{
+    update(key, false);
+}
+
+lib::static_key *lib::static_keys::find(const char *name, size_t length)
+{
+    lib::cmdline::option word = { name, length, nullptr, 0 };
+
+    for (auto *entry = __jump_table_start; entry < __jump_table_end; entry++) {
+        if (word.is(entry->key->name)) {
+            return entry->key;
+        }
+    }
+
+    return nullptr;
+}
+
+size_t lib::static_keys::parse_cmdline(const char *cmdline)
+{
+    size_t enabled = 0;
+    lib::cmdline::option option;
+
+    while (lib::cmdline::next(cmdline, option)) {
+        if (!option.is("debug")) {
+            continue;
+        }
+
+        const char *s = option.value;
+        const char *end = option.value + option.value_length;
+
+        while (s < end) {
+            const char *name = s;
+            while (s < end && *s != ',') {
+                s++;
+            }
+
+            auto length = static_cast<size_t>(s - name);
+            auto *key = find(name, length);
+            if (key != nullptr) {
+                enable(*key);
+                lib::log(lib::log_level::INFO, "static key {} enabled", key->name);
+                enabled++;
+            }
+            else if (length > 0) {
+                lib::log(lib::log_level::WARNING, "debug=: unknown static key");
+            }
+
+            s++;
+        }
+    }
+
+    return enabled;
+}
\ No newline at end of file
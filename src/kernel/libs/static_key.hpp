@@ -0,0 +1,75 @@
+#ifndef STATIC_KEY_HPP
+#define STATIC_KEY_HPP
+
+#include "stdint.hpp"
+
+/*
+ * Boot time patched branches
+ *
+ * A static key is a branch that costs a 5 byte NOP while disabled:
+ *
+ *     lib::static_key heap_checks = { "heap_checks", false };
+ *
+ *     if (lib::static_branch<heap_checks>() && !block->is_valid()) {
+ *         ...
+ *     }
+ *
+ * Every static_branch() site records the NOP address, the address of the
+ * enabled path and its key in the __jump_table section. enable() rewrites
+ * the NOP of every site of that key into a jmp to the enabled path,
+ * disable() puts the NOP back, so the check itself is never evaluated
+ * while the key is off.
+ *
+ * Keys are turned on from the multiboot command line, comma separated:
+ *
+ *     debug=heap_checks,alloc_trace
+ *
+ * A key nobody branches on isn't in the table and can't be found by name.
+ * Patching isn't synchronized with other cpus, keys are meant to be
+ * flipped at boot while only the BSP runs.
+ */
+namespace lib
+{
+    struct static_key
+    {
+        const char *name;
+        bool        enabled;
+    };
+
+    struct jump_entry
+    {
+        uint64_t    code;
+        uint64_t    target;
+        static_key *key;
+    };
+
+    // false until the key is enabled, must be inlined for the table entry
+    // to point at this site
+    template <static_key &Key>
+    [[gnu::always_inline]] inline bool static_branch()
+    {
+        asm goto("1: .byte 0x0f, 0x1f, 0x44, 0x00, 0x00\n\t"
+                 ".pushsection __jump_table, \"aw\"\n\t"
+                 ".balign 8\n\t"
+                 ".quad 1b, %l[enabled], %c0\n\t"
+                 ".popsection"
+                 : : "i"(&Key) : : enabled);
+        return false;
+
+    enabled:
+        return true;
+    }
+
+    namespace static_keys
+    {
+        void enable(static_key &key);
+        void disable(static_key &key);
+
+        static_key *find(const char *name, size_t length);
+
+        // enables every key listed by the debug= option, returns how many
+        size_t parse_cmdline(const char *cmdline);
+    }
+}
+
+#endif // STATIC_KEY_HPP
\ No newline at end of file
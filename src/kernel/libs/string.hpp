@@ -3,15 +3,80 @@
 
 #include "stdint.hpp"
 
+/*
+ * Memory and string primitives
+ *
+ * Bulk operations use the string instructions. With ERMS (enhanced rep
+ * movsb/stosb) the byte forms run at full width for large sizes, FSRM
+ * (fast short rep movsb) makes movsb cheap for short copies too, stosb
+ * has no such fast path. Without them the qword forms plus a byte tail
+ * are used. string_setup() records what the cpu has, until it's called
+ * the qword paths are taken.
+ *
+ * zero_page() and copy_page() work on whole 4KB frames with non-temporal
+ * stores (movnti): a frame being cleared or duplicated is rarely read
+ * right away, writing around the cache keeps it from evicting the lines
+ * running tasks are using. Page tables are the exception: the MMU walks
+ * them and the caller fills them in right after, clear those with
+ * memset().
+ */
 namespace lib
 {
+    // unaligned qword accesses that may alias anything
+    typedef uint64_t __attribute__((may_alias, aligned(1))) unaligned_u64;
+
+    constexpr size_t   PAGE_BYTES  = 4_KB;
+
+    constexpr uint64_t BYTES_ONES  = 0x0101010101010101ull;
+    constexpr uint64_t BYTES_HIGHS = 0x8080808080808080ull;
+
+    // below this, rep movsb/stosb startup costs more than it saves, FSRM
+    // lifts the limit for movsb only
+    constexpr size_t REP_BYTES_THRESHOLD = 128;
+
+    inline bool has_erms_ = false;
+    inline bool has_fsrm_ = false;
+
+    inline void string_setup(bool erms, bool fsrm)
+    {
+        has_erms_ = erms;
+        has_fsrm_ = fsrm;
+    }
+
+    inline bool use_rep_movsb(size_t count)
+    {
+        return has_erms_ && (has_fsrm_ || count >= REP_BYTES_THRESHOLD);
+    }
+
+    inline bool use_rep_stosb(size_t count)
+    {
+        return has_erms_ && count >= REP_BYTES_THRESHOLD;
+    }
+
     inline size_t strlen(const char *str)
     {
-        size_t len = 0;
-        while (str[len] != '\0') {
-            len++;
+        const char *p = str;
+
+        // an aligned qword never crosses a page, reading past the
+        // terminator inside it can't fault
+        while (ptr_from(p) & (sizeof(uint64_t) - 1)) {
+            if (*p == '\0') {
+                return p - str;
+            }
+            p++;
+        }
+
+        auto *word = reinterpret_cast<const unaligned_u64*>(p);
+        while (((*word - BYTES_ONES) & ~*word & BYTES_HIGHS) == 0) {
+            word++;
         }
-        return len;
+
+        p = reinterpret_cast<const char*>(word);
+        while (*p != '\0') {
+            p++;
+        }
+
+        return p - str;
     }
 
     inline bool isdigit(char c)
@@ -21,25 +86,51 @@ namespace lib
 
     inline void *memset(void *ptr, unsigned char ch, size_t count)
     {
-        unsigned char *p = static_cast<unsigned char *>(ptr);
-        while (count > 0) {
-            *p++ = ch;
-            count--;
+        void *p = ptr;
+
+        if (use_rep_stosb(count)) {
+            asm volatile("rep stosb"
+                         : "+D"(p), "+c"(count)
+                         : "a"(ch)
+                         : "memory");
+            return ptr;
         }
-        
+
+        size_t qwords = count / sizeof(uint64_t);
+        size_t bytes  = count % sizeof(uint64_t);
+
+        asm volatile("rep stosq\n\t"
+                     "mov %2, %%rcx\n\t"
+                     "rep stosb"
+                     : "+D"(p), "+c"(qwords)
+                     : "r"(bytes), "a"(ch * BYTES_ONES)
+                     : "memory");
+
         return ptr;
     }
 
     inline void *memcpy(void *dest, const void *src, size_t count)
     {
-        unsigned char *d = static_cast<unsigned char *>(dest);
-        const unsigned char *s = static_cast<const unsigned char *>(src);
-        
-        while (count > 0) {
-            *d++ = *s++;
-            count--;
+        void *d = dest;
+
+        if (use_rep_movsb(count)) {
+            asm volatile("rep movsb"
+                         : "+D"(d), "+S"(src), "+c"(count)
+                         :
+                         : "memory");
+            return dest;
         }
-        
+
+        size_t qwords = count / sizeof(uint64_t);
+        size_t bytes  = count % sizeof(uint64_t);
+
+        asm volatile("rep movsq\n\t"
+                     "mov %3, %%rcx\n\t"
+                     "rep movsb"
+                     : "+D"(d), "+S"(src), "+c"(qwords)
+                     : "r"(bytes)
+                     : "memory");
+
         return dest;
     }
 
@@ -47,23 +138,66 @@ namespace lib
     {
         unsigned char *d = static_cast<unsigned char *>(dest);
         const unsigned char *s = static_cast<const unsigned char *>(src);
-        
-        if (d < s) {
-            while (count > 0) {
-                *d++ = *s++;
-                count--;
-            }
-        } else {
-            d += count;
-            s += count;
-            while (count > 0) {
-                *(--d) = *(--s);
-                count--;
-            }
+
+        // forward string moves are defined byte by byte, so they are safe
+        // whenever the destination starts below the source
+        if (d <= s || d >= s + count) {
+            return memcpy(dest, src, count);
+        }
+
+        // overlapping with dest above src: copy from the end, qwords first
+        while (count >= sizeof(uint64_t)) {
+            count -= sizeof(uint64_t);
+            *reinterpret_cast<unaligned_u64*>(d + count) = *reinterpret_cast<const unaligned_u64*>(s + count);
+        }
+
+        while (count > 0) {
+            count--;
+            d[count] = s[count];
         }
-        
+
         return dest;
     }
+
+    // page must be PAGE_BYTES aligned
+    inline void zero_page(void *page)
+    {
+        auto *p = static_cast<uint64_t *>(page);
+        uint64_t zero = 0;
+
+        for (size_t i = 0; i < PAGE_BYTES / sizeof(uint64_t); i += 4) {
+            asm volatile("movnti %1,   (%0)\n\t"
+                         "movnti %1,  8(%0)\n\t"
+                         "movnti %1, 16(%0)\n\t"
+                         "movnti %1, 24(%0)"
+                         :
+                         : "r"(p + i), "r"(zero)
+                         : "memory");
+        }
+
+        // weakly ordered stores, make them visible before the frame is used
+        asm volatile("sfence" : : : "memory");
+    }
+
+    inline void copy_page(void *dest, const void *src)
+    {
+        auto *d = static_cast<uint64_t *>(dest);
+        auto *s = static_cast<const uint64_t *>(src);
+
+        for (size_t i = 0; i < PAGE_BYTES / sizeof(uint64_t); i += 4) {
+            uint64_t a = s[i], b = s[i + 1], c = s[i + 2], e = s[i + 3];
+
+            asm volatile("movnti %1,   (%0)\n\t"
+                         "movnti %2,  8(%0)\n\t"
+                         "movnti %3, 16(%0)\n\t"
+                         "movnti %4, 24(%0)"
+                         :
+                         : "r"(d + i), "r"(a), "r"(b), "r"(c), "r"(e)
+                         : "memory");
+        }
+
+        asm volatile("sfence" : : : "memory");
+    }
 }
 
 #endif // STRING_HPP
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "tunables.hpp"
+#include "cmdline.hpp"
+#include "logger.hpp"
+
+#include "config.hpp"
+#include "arch/iprotected_mode.hpp"
+
+enum class kind : uint8_t
+{
+    NUMBER,
+    SIZE,
+    LEVEL
+};
+
+struct tunable
+{
+    const char *name;
+    kind        type;
+    uint64_t    value;
+    uint64_t    min;
+    uint64_t    max;
+    bool        set;
+};
+
+// indexed by lib::tunables::id, value holds the default until parsed
+static tunable tunables_[lib::tunables::COUNT] = {
+    { "heap.initial_size",  kind::SIZE,      1_MB,  64_KB,     256_MB, false },
+    { "heap.grow_size",     kind::SIZE,      4_KB,  4_KB,      64_MB,  false },
+    { "kthread.stack_size", kind::SIZE,      16_KB, 8_KB,      1_MB,   false },
+    // the PIT divisor is 16 bits, 19 Hz is the slowest it can tick
+    { "timer.hz",           kind::NUMBER,    100,   19,        10'000, false },
+    { "log.level",          kind::LEVEL,     0,     0,         4,      false },
+};
+
+static const char *level_names[] = { "trace", "info", "warning", "error", "critical" };
+
+static bool parse_number(const char *s, size_t length, kind type, uint64_t &out)
+{
+    if (type == kind::LEVEL) {
+        lib::cmdline::option word = { s, length, nullptr, 0 };
+
+        for (size_t i = 0; i < sizeof(level_names) / sizeof(level_names[0]); i++) {
+            if (word.is(level_names[i])) {
+                out = i;
+                return true;
+            }
+        }
+    }
+
+    if (length == 0) {
+        return false;
+    }
+
+    uint64_t shift = 0;
+    if (type == kind::SIZE) {
+        switch (s[length - 1]) {
+            case 'K': case 'k': shift = 10; length--; break;
+            case 'M': case 'm': shift = 20; length--; break;
+            case 'G': case 'g': shift = 30; length--; break;
+        }
+    }
+
+    if (length == 0 || length > 19) {
+        return false;
+    }
+
+    uint64_t value = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (s[i] < '0' || s[i] > '9') {
+            return false;
+        }
+        value = value * 10 + static_cast<uint64_t>(s[i] - '0');
+    }
+
+    if (shift > 0 && value > (~0ull >> shift)) {
+        return false;
+    }
+
+    out = value << shift;
+    return true;
+}
+
+uint64_t lib::tunables::value(id which)
+{
+    return (which < COUNT) ? tunables_[which].value : 0;
+}
+
+size_t lib::tunables::parse_cmdline(const char *cmdline)
+{
+    size_t count = 0;
+    lib::cmdline::option option;
+
+    while (lib::cmdline::next(cmdline, option)) {
+        for (auto &entry : tunables_) {
+            if (!option.is(entry.name)) {
+                continue;
+            }
+
+            uint64_t value;
+            if (!parse_number(option.value, option.value_length, entry.type, value) ||
+                value < entry.min || value > entry.max) {
+                lib::log(lib::log_level::WARNING, "{}: invalid value, keeping {}", entry.name, entry.value);
+                break;
+            }
+
+            entry.value = value;
+            entry.set = true;
+            count++;
+            break;
+        }
+    }
+
+    return count;
+}
+
+void lib::tunables::print(iprotected_mode *out)
+{
+    for (const auto &entry : tunables_) {
+        if (entry.type == kind::LEVEL) {
+            out->format("{:<20} {}", entry.name, level_names[entry.value]);
+        }
+        else {
+            out->format("{:<20} {}", entry.name, entry.value);
+        }
+        out->prints(entry.set ? " (command line)\n" : "\n");
+    }
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef TUNABLES_HPP
+#define TUNABLES_HPP
+
+#include "stdint.hpp"
+
+class iprotected_mode;
+
+/*
+ * Boot time tunables
+ *
+ * Parameters that used to be compile time constants, each with a built-in
+ * default and a valid range. kmain parses the multiboot command line once,
+ * before memory is initialized, and every subsystem reads its value with
+ * get():
+ *
+ *     multiboot /boot/coronel heap.initial_size=4M timer.hz=1000 log.level=info
+ *
+ *     auto size = lib::tunables::get<size_t>(lib::tunables::HEAP_INITIAL_SIZE);
+ *
+ * Sizes take a K, M or G suffix, log.level takes a level name or number.
+ * A value that doesn't parse or is out of range keeps the default and is
+ * reported. Options that aren't tunables are left to their own parsers
+ * (debug= belongs to lib::static_keys).
+ */
+namespace lib::tunables
+{
+    enum id : uint8_t
+    {
+        HEAP_INITIAL_SIZE,      // heap.initial_size, kernel heap mapped at boot
+        HEAP_GROW_SIZE,         // heap.grow_size, least the heap grows by
+        KTHREAD_STACK_SIZE,     // kthread.stack_size, stack of each kernel thread
+        TIMER_HZ,               // timer.hz, periodic tick frequency
+        SERIAL_LOG_LEVEL,       // log.level, least level written to COM1
+        COUNT
+    };
+
+    uint64_t value(id which);
+
+    template <typename T = uint64_t>
+    inline T get(id which)
+    {
+        return static_cast<T>(value(which));
+    }
+
+    // returns how many tunables were set
+    size_t parse_cmdline(const char *cmdline);
+
+    void print(iprotected_mode *out);
+}
+
+#endif // TUNABLES_HPP
\ No newline at end of file
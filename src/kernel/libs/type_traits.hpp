@@ -44,6 +44,16 @@ namespace lib
     template <typename T>
     using remove_extent_t = typename remove_extent<T>::type;
 
+    // blocks template argument deduction through a parameter
+    template <typename T>
+    struct type_identity
+    {
+        typedef T type;
+    };
+
+    template <typename T>
+    using type_identity_t = typename type_identity<T>::type;
+
 
     template <typename T>
     constexpr T &&forward(remove_reference<T>& t) noexcept
@@ -108,6 +118,10 @@ namespace lib
     template <> struct is_integral<uint16_t>  : true_type {};
     template <> struct is_integral<uint32_t>  : true_type {};
     template <> struct is_integral<uint64_t>  : true_type {};
+    template <> struct is_integral<long>      : true_type {};
+    template <> struct is_integral<unsigned long> : true_type {};
+    template <> struct is_integral<char>      : true_type {};
+    template <> struct is_integral<bool>      : true_type {};
 
     template <class T>
     inline constexpr bool is_integral_v = is_integral<T>::value;
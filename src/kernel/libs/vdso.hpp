@@ -0,0 +1,97 @@
+#ifndef VDSO_HPP
+#define VDSO_HPP
+
+#include "stdint.hpp"
+
+/*
+ * vDSO time page
+ *
+ * The kernel maps one read-only page at USER_VDSO_ADDR into every user
+ * address space and updates it from the timer interrupt. User code reads
+ * the time straight from it, no syscall involved:
+ *
+ *     auto *data = ptr_to<const vdso::time_data*>(vdso::USER_VDSO_ADDR);
+ *     uint64_t now = vdso::read_ns(data);
+ *
+ * Consistency is guaranteed by a seqlock: the writer makes seq odd, stores
+ * the fields and makes seq even again. Readers retry whenever they observe
+ * an odd seq or seq changed while they were reading.
+ *
+ * Between ticks the time is extrapolated with the TSC:
+ *     ns = ns_at_tick + ((rdtsc() - tsc_at_tick) * tsc_mult) >> tsc_shift
+ *
+ * This header is shared with user space, keep it free of kernel includes.
+ */
+namespace vdso
+{
+    constexpr uintptr_t USER_VDSO_ADDR = 0x70000000;
+
+    struct time_data
+    {
+        uint32_t seq;
+        uint32_t frequency;     // timer interrupts per second
+        uint64_t ticks;         // timer interrupts since boot
+
+        uint64_t tsc_hz;        // calibrated TSC frequency, 0 if unknown
+        uint64_t tsc_at_tick;   // TSC value sampled at the last tick
+        uint64_t ns_at_tick;    // nanoseconds since boot at the last tick
+        uint64_t tsc_mult;      // ns = (tsc delta * tsc_mult) >> tsc_shift
+        uint32_t tsc_shift;
+    };
+
+    inline uint64_t read_tsc()
+    {
+        uint32_t lo, hi;
+        asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+        return (static_cast<uint64_t>(hi) << 32) | lo;
+    }
+
+    inline uint32_t read_begin(const time_data *data)
+    {
+        uint32_t seq;
+        do {
+            seq = __atomic_load_n(&data->seq, __ATOMIC_ACQUIRE);
+        } while (seq & 1);
+
+        return seq;
+    }
+
+    inline bool read_retry(const time_data *data, uint32_t seq)
+    {
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        return __atomic_load_n(&data->seq, __ATOMIC_RELAXED) != seq;
+    }
+
+    inline uint64_t read_ticks(const time_data *data)
+    {
+        uint32_t seq;
+        uint64_t ticks;
+
+        do {
+            seq   = read_begin(data);
+            ticks = data->ticks;
+        } while (read_retry(data, seq));
+
+        return ticks;
+    }
+
+    inline uint64_t read_ns(const time_data *data)
+    {
+        uint32_t seq;
+        uint64_t ns;
+
+        do {
+            seq = read_begin(data);
+
+            ns = data->ns_at_tick;
+            if (data->tsc_mult != 0) {
+                uint64_t delta = read_tsc() - data->tsc_at_tick;
+                ns += (delta * data->tsc_mult) >> data->tsc_shift;
+            }
+        } while (read_retry(data, seq));
+
+        return ns;
+    }
+}
+
+#endif // VDSO_HPP
\ No newline at end of file
@@ -1,22 +1,91 @@
+#include "libs/boot_profile.hpp"
+#include "libs/logger.hpp"
+#include "libs/profiler.hpp"
+#include "libs/static_key.hpp"
+#include "libs/tunables.hpp"
 #include "libs/multiboot.hpp"
+#include "drivers/acpi/acpi.hpp"
 #include "drivers/bus/pci.hpp"
 #include "memory/memory_manager.hpp"
 
 #include "archs.hpp"
 #include "config.hpp"
 #include "drivers/peripherals/keyboard.hpp"
+#include "drivers/peripherals/serial.hpp"
+#include "syscall/ring.hpp"
+#include "task/softirq.hpp"
+#include "task/task.hpp"
+#include "task/workqueue.hpp"
 
+#ifdef CORONEL_BENCH
+#include "bench/bench.hpp"
+#endif
 
-void force_pic_mode() {
-    // Disable APIC if present to force PIC mode
-    // Check if APIC is enabled via MSR
-    uint32_t eax, edx;
-    asm volatile("rdmsr" : "=a"(eax), "=d"(edx) : "c"(0x1B));  // IA32_APIC_BASE MSR
-    
-    if (eax & 0x800) {  // APIC Global Enable bit
-        // Disable APIC to force PIC mode
-        eax &= ~0x800;
-        asm volatile("wrmsr" : : "a"(eax), "d"(edx), "c"(0x1B));
+constexpr uint16_t SCANCODE_F9  = 0x43;
+constexpr uint16_t SCANCODE_F10 = 0x44;
+constexpr uint16_t SCANCODE_F11 = 0x57;
+constexpr uint16_t SCANCODE_F12 = 0x58;
+
+// one profiler sample every this many unhalted cycles
+constexpr uint32_t PMU_SAMPLE_PERIOD = 1000000;
+
+// echoes the keyboard on the console, parks in read() between keys.
+// F11 starts the profiler, the next F11 dumps the samples to COM1. F12
+// does the same sampling on cycle counter overflows, F9 lists the
+// hardware counters charged to each task
+static void console_thread(void *data)
+{
+    auto *arch = static_cast<iarch*>(data);
+    auto &keyboard = peripherals::add_keyboard(arch);
+    auto *video = arch->get_video();
+    auto *serial = peripherals::add_serial(arch);
+
+    peripherals::key_event events[16];
+
+    while (true) {
+        auto count = keyboard.read(events, sizeof(events) / sizeof(events[0]));
+
+        for (size_t i = 0; i < count; i++) {
+            if (!events[i].pressed) {
+                continue;
+            }
+
+            if (events[i].scancode == SCANCODE_F9) {
+                arch->print_task_counters(video);
+            }
+            else if (events[i].scancode == SCANCODE_F10) {
+                arch->print_interrupt_stats(video);
+            }
+            else if (events[i].scancode == SCANCODE_F12) {
+                if (arch->sampling()) {
+                    arch->stop_sampling();
+                    lib::profiler::dump(serial);
+                    video->prints("Profile written to COM1\n");
+                }
+                else if (!lib::profiler::running() && arch->start_sampling(PMU_SAMPLE_PERIOD)) {
+                    lib::profiler::start(lib::profiler::source::PMU);
+                    video->prints("Sampling cycles, F12 to stop\n");
+                }
+                else {
+                    video->prints("Cycle sampling unavailable\n");
+                }
+            }
+            else if (events[i].scancode == SCANCODE_F11 && !arch->sampling()) {
+                if (lib::profiler::running()) {
+                    lib::profiler::dump(serial);
+                    video->prints("Profile written to COM1\n");
+                }
+                else {
+                    lib::profiler::start();
+                    video->prints("Profiling, F11 to stop\n");
+                }
+            }
+            else if (events[i].ascii != 0) {
+                video->printc(events[i].ascii);
+            }
+        }
+
+        video->flush();
     }
 }
 
@@ -39,12 +108,51 @@ void kmain(multiboot_info_t *bootinfo, unsigned long magic)
     video->clear();
     video->print("Welcome to CoronelOS!\nArch: ", archs::get_arch_name(), '\n');
 
+    // tunables size the heap and the tick, take them before anything runs
+    if (bootinfo->flags & MULTIBOOT_INFO_CMDLINE) {
+        auto *cmdline = reinterpret_cast<const char*>(bootinfo->cmdline + KVIRTUAL_ADDRESS);
+        lib::tunables::parse_cmdline(cmdline);
+        lib::static_keys::parse_cmdline(cmdline);
+    }
+
     // Initialize memory management early
     memory::initialize_memory(bootinfo);
+    lib::boot_profile::mark("memory");
+
+    // the framebuffer console needs the heap for its shadow buffer, VGA
+    // text memory is invisible once the bootloader set a graphics mode
+    if (arch->setup_framebuffer(bootinfo)) {
+        video = arch->get_video();
+        video->print("Welcome to CoronelOS!\nArch: ", archs::get_arch_name(), '\n');
+    }
+    lib::boot_profile::mark("framebuffer");
+
+    // kmain becomes the idle task. The timer tick and the keyboard decode
+    // run as softirqs, the log drain as work on the worker thread, which
+    // also catches softirqs the interrupt exit left behind
+    auto &tasks = get_task_manager();
+    tasks.init();
+    softirq::setup();
+    workqueue::setup();
+    lib::boot_profile::mark("tasks");
+
+    // COM1 mirrors the boot log for headless runs (-serial stdio)
+    auto *serial = peripherals::add_serial(arch);
+    if (serial != nullptr) {
+        serial->print("Welcome to CoronelOS!\nArch: ", archs::get_arch_name(), '\n');
+        video->prints("Serial console on COM1\n");
+    }
+
+    // everything goes to the serial port, only errors reach the screen
+    lib::logger::add_sink(serial, lib::tunables::get<lib::log_level>(lib::tunables::SERIAL_LOG_LEVEL));
+    lib::logger::add_sink(video, lib::log_level::ERROR);
+    lib::boot_profile::mark("serial");
 
     if (bootinfo->flags & MULTIBOOT_INFO_CMDLINE) {
         uintptr_t cmdline = bootinfo->cmdline + KVIRTUAL_ADDRESS;
-        video->print("Command line: ", reinterpret_cast<char*>(cmdline), "\n\n");
+        video->print("Command line: ", reinterpret_cast<char*>(cmdline), "\n");
+        lib::tunables::print(video);
+        video->prints("\n");
     }
     
     if (bootinfo->flags & MULTIBOOT_INFO_VBE_INFO) {
@@ -82,16 +190,63 @@ void kmain(multiboot_info_t *bootinfo, unsigned long magic)
     video->prints("Scanning PCI devices...\n");
     auto &pci = bus::get_pci(arch);
     pci.scan_hardware();
+    lib::boot_profile::mark("pci");
 
-    auto timer = peripherals::add_timer(arch, 100);
+    // switch from the 8259s to IOAPIC routing when ACPI describes it
+    if (acpi::setup(arch) && arch->route_interrupts(acpi::get_madt())) {
+        video->prints("Interrupts routed through the IOAPIC\n");
+    }
+    lib::boot_profile::mark("interrupts");
+
+    auto &timer = peripherals::add_timer(arch, lib::tunables::get<uint32_t>(lib::tunables::TIMER_HZ));
+    lib::boot_profile::mark("timer");
+
+    // the other cores only idle for now, everything keeps running here
+    auto cpus = arch->start_cpus(acpi::get_madt(), timer.get_tsc_frequency());
+    video->format("{} cpu(s) online\n", cpus);
+    lib::boot_profile::mark("smp");
     peripherals::add_keyboard(arch);
+    lib::boot_profile::mark("keyboard");
+
+#ifdef CORONEL_BENCH
+    // coronel-bench: report to COM1 and leave QEMU, never returns
+    bench::run(arch, serial, timer);
+#endif
+
+    tasks.create_kernel_thread(console_thread, arch);
 
     // Print memory information
     memory::print_memory_info();
 
-    /*
+    lib::boot_profile::mark("boot_done");
+    lib::boot_profile::report(video, timer.get_tsc_frequency());
+#ifdef BOOT_TRACE
+    lib::boot_profile::trace(serial, timer.get_tsc_frequency());
+#endif
+
     while (true) {
+        // run whatever the bottom halves woke up
+        tasks.yield();
+
+        // drain RING_SETUP_POLL submission rings between interrupts, the
+        // entries may wake tasks as well
+        bool polling = syscall::ring_poll();
+
+        // decide with interrupts off: a wakeup from here on stays pending
+        // and ends the hlt in cpu_halt() instead of being lost before it
+        auto flags = arch->irq_save();
+        if (!tasks.idle()) {
+            arch->irq_restore(flags);
+            continue;
+        }
+
+        // with nothing left to poll the cpu can sleep without the periodic tick
+        if (!polling) {
+            timer.stop_tick();
+        }
+
         arch->cpu_halt();
+        timer.restart_tick();
+        arch->irq_restore(flags);
     }
-    */
 }
\ No newline at end of file
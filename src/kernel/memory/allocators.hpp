@@ -20,6 +20,7 @@ namespace memory {
     void* krealloc(void* ptr, size_t new_size);
     void* kcalloc(size_t num, size_t size);
     void* kmalloc_aligned(size_t alignment, size_t size);
+    void kfree_aligned(void* ptr);
 }
 
 #endif // ALLOCATORS_HPP
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "config.hpp"
 #include "libs/logger.hpp"
 #include "libs/string.hpp"
+#include "libs/tunables.hpp"
 #include "arch/amd64/memory/paging.hpp"
 
 namespace memory {
@@ -12,6 +13,7 @@ namespace memory {
 
     // Global heap instance
     heap* g_kernel_heap = nullptr;
+    lib::static_key heap_checks = { "heap_checks", false };
 
     heap::heap(physical* phys, virt* virt_mgr, vaddr_t start, size_t initial_size) :
         phys_manager_(phys),
@@ -87,7 +89,7 @@ namespace memory {
             }
             
             // Clear the page
-            lib::memset(reinterpret_cast<void*>(virt_addr), 0, FRAME_SIZE);
+            lib::zero_page(reinterpret_cast<void*>(virt_addr));
         }
         
         return true;
@@ -108,6 +110,10 @@ namespace memory {
     {
         // Calculate how much to expand (at least min_size, but align to pages)
         size_t expand_size = HEAP_ALIGN_UP(min_size);
+        size_t grow_size = lib::tunables::get<size_t>(lib::tunables::HEAP_GROW_SIZE);
+        if (expand_size < grow_size) {
+            expand_size = HEAP_ALIGN_UP(grow_size);
+        }
         
         // Allocate virtual memory for expansion
         vaddr_t new_region = virt_manager_->alloc(expand_size);
@@ -183,7 +189,7 @@ namespace memory {
         // Update original block
         block->size = size;
         
-        total_free_ += sizeof(heap_block); // We added a new header
+        total_free_ -= sizeof(heap_block); // The new header takes free space
     }
 
     void heap::coalesce_block(heap_block* block)
@@ -206,7 +212,7 @@ namespace memory {
                     next_block->next->prev = block;
                 }
                 
-                total_free_ -= sizeof(heap_block); // We removed a header
+                total_free_ += sizeof(heap_block); // The merged header is free space now
             }
         }
         
@@ -224,7 +230,7 @@ namespace memory {
                     block->next->prev = prev_block;
                 }
                 
-                total_free_ -= sizeof(heap_block); // We removed a header
+                total_free_ += sizeof(heap_block); // The merged header is free space now
             }
         }
     }
@@ -262,9 +268,9 @@ namespace memory {
         block->is_free = false;
         block->magic = heap_block::MAGIC_USED;
         
-        // Update statistics
-        total_allocated_ += size;
-        total_free_ -= size;
+        // Update statistics, an unsplit block hands out its whole size
+        total_allocated_ += block->size;
+        total_free_ -= block->size;
         num_allocations_++;
         
         return block->data();
@@ -279,7 +285,7 @@ namespace memory {
         heap_block* block = heap_block::from_data(ptr);
         
         // Validate block
-        if (!block->is_valid() || block->is_free) {
+        if ((lib::static_branch<heap_checks>() && !block->is_valid()) || block->is_free) {
             lib::log(lib::log_level::CRITICAL, "Invalid free: corrupted block or double free");
             return;
         }
@@ -309,7 +315,7 @@ namespace memory {
         }
         
         heap_block* block = heap_block::from_data(ptr);
-        if (!block->is_valid() || block->is_free) {
+        if ((lib::static_branch<heap_checks>() && !block->is_valid()) || block->is_free) {
             lib::log(lib::log_level::CRITICAL, "Invalid realloc: corrupted block");
             return nullptr;
         }
@@ -377,7 +383,7 @@ namespace memory {
         
         // Calculate aligned address
         uintptr_t raw_addr = ptr_from(raw_ptr);
-        uintptr_t aligned_addr = HEAP_ALIGN_UP(raw_addr + sizeof(void*));
+        uintptr_t aligned_addr = (raw_addr + sizeof(void*) + alignment - 1) & ~(alignment - 1);
         
         // Store original pointer just before aligned address
         void** orig_ptr_storage = reinterpret_cast<void**>(aligned_addr - sizeof(void*));
@@ -386,6 +392,16 @@ namespace memory {
         return reinterpret_cast<void*>(aligned_addr);
     }
 
+    void heap::aligned_free(void* ptr)
+    {
+        if (ptr == nullptr) {
+            return;
+        }
+
+        // aligned_alloc keeps the malloc'ed pointer right before ptr
+        free(reinterpret_cast<void**>(ptr)[-1]);
+    }
+
     bool heap::validate_heap() const
     {
         heap_block* current = first_block_;
@@ -435,7 +451,7 @@ namespace memory {
         }
         
         // Allocate virtual address space for heap (start after kernel)
-        const size_t INITIAL_HEAP_SIZE = 1_MB; // Start with 1MB heap
+        const size_t INITIAL_HEAP_SIZE = HEAP_ALIGN_UP(lib::tunables::get<size_t>(lib::tunables::HEAP_INITIAL_SIZE));
         
         vaddr_t heap_vaddr = virt_mgr->alloc(INITIAL_HEAP_SIZE);
         if (heap_vaddr == nullptr) {
@@ -498,4 +514,13 @@ namespace memory {
         
         return g_kernel_heap->aligned_alloc(alignment, size);
     }
+
+    void kfree_aligned(void* ptr)
+    {
+        if (g_kernel_heap == nullptr || ptr == nullptr) {
+            return;
+        }
+
+        g_kernel_heap->aligned_free(ptr);
+    }
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define HEAP_HPP
 
 #include "libs/stdint.hpp"
+#include "libs/static_key.hpp"
 #include "physical.hpp"
 #include "virtual.hpp"
 
@@ -25,6 +26,9 @@ namespace memory
     // Global heap instance
     extern heap* g_kernel_heap;
 
+    // block magic checks on free/realloc, off unless debug=heap_checks
+    extern lib::static_key heap_checks;
+
     // Heap block header - every allocation has this header
     struct heap_block
     {
@@ -109,6 +113,7 @@ namespace memory
         
         // Alignment-aware allocation
         void* aligned_alloc(size_t alignment, size_t size);
+        void aligned_free(void* ptr);
         
         // Statistics and debugging
         void print_stats() const;
@@ -134,6 +139,7 @@ namespace memory
     void* krealloc(void* ptr, size_t new_size);
     void* kcalloc(size_t num, size_t size);
     void* kmalloc_aligned(size_t alignment, size_t size);
+    void kfree_aligned(void* ptr);
 }
 
 #endif // HEAP_HPP
\ No newline at end of file
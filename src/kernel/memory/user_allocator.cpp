@@ -231,9 +231,9 @@ namespace memory {
         // Split block if beneficial
         split_block(block, aligned_size);
         
-        // Mark as used
+        // Mark as used, an unsplit block hands out its whole size
         block->set_free(false);
-        total_allocated_ += aligned_size;
+        total_allocated_ += block->size;
         
         return block->data();
     }
@@ -247,7 +247,7 @@ namespace memory {
         user_block* block = user_block::from_data(ptr);
         
         // Validate block
-        if (!block->is_valid() || block->is_free()) {
+        if ((lib::static_branch<heap_checks>() && !block->is_valid()) || block->is_free()) {
             return; // Invalid or double free
         }
         
@@ -271,7 +271,7 @@ namespace memory {
         }
         
         user_block* block = user_block::from_data(ptr);
-        if (!block->is_valid() || block->is_free()) {
+        if ((lib::static_branch<heap_checks>() && !block->is_valid()) || block->is_free()) {
             return nullptr;
         }
         
@@ -282,6 +282,7 @@ namespace memory {
         if (aligned_new_size <= old_size) {
             if (old_size > aligned_new_size + sizeof(user_block) + 16) {
                 split_block(block, aligned_new_size);
+                total_allocated_ -= old_size - block->size;
             }
             return ptr;
         }
@@ -436,7 +437,8 @@ namespace memory {
             heap_ = nullptr;
         }
         
-        // TODO: unmap all process pages here
+        // TODO: unmap all process pages here, syscall::ring_release has to
+        // run before the page directory is freed
     }
 
     bool process_memory::validate_user_pointer(void* ptr, size_t size) const
@@ -466,50 +468,67 @@ namespace memory {
 
     // System call implementations
     namespace syscalls {
+        // one record per call, off unless debug=alloc_trace
+        static lib::static_key alloc_trace = { "alloc_trace", false };
+
         extern "C" void* sys_malloc(size_t size)
         {
             // TODO: get the current process context
-            lib::log(lib::log_level::INFO, "sys_malloc called");
+            if (lib::static_branch<alloc_trace>()) {
+                lib::log(lib::log_level::INFO, "sys_malloc called");
+            }
             return nullptr; // call current_process->memory->heap->malloc(size)
         }
 
         extern "C" void sys_free(void* ptr)
         {
             // current_process->memory->heap->free(ptr)
-            lib::log(lib::log_level::INFO, "sys_free called");
+            if (lib::static_branch<alloc_trace>()) {
+                lib::log(lib::log_level::INFO, "sys_free called");
+            }
         }
 
         extern "C" void* sys_realloc(void* ptr, size_t new_size)
         {
             // current_process->memory->heap->realloc(ptr, new_size)
-            lib::log(lib::log_level::INFO, "sys_realloc called");
+            if (lib::static_branch<alloc_trace>()) {
+                lib::log(lib::log_level::INFO, "sys_realloc called");
+            }
             return nullptr;
         }
 
         extern "C" void* sys_calloc(size_t num, size_t size)
         {
             // current_process->memory->heap->calloc(num, size)
-            lib::log(lib::log_level::INFO, "sys_calloc called");
+            if (lib::static_branch<alloc_trace>()) {
+                lib::log(lib::log_level::INFO, "sys_calloc called");
+            }
             return nullptr;
         }
 
         extern "C" int sys_brk(void* addr)
         {
-            lib::log(lib::log_level::INFO, "sys_brk called");
+            if (lib::static_branch<alloc_trace>()) {
+                lib::log(lib::log_level::INFO, "sys_brk called");
+            }
             return -1;
         }
 
         extern "C" void* sys_mmap(void* addr, size_t length, int prot, int flags)
         {
             // Memory mapping system call
-            lib::log(lib::log_level::INFO, "sys_mmap called");
+            if (lib::static_branch<alloc_trace>()) {
+                lib::log(lib::log_level::INFO, "sys_mmap called");
+            }
             return nullptr;
         }
 
         extern "C" int sys_munmap(void* addr, size_t length)
         {
             // Unmap memory
-            lib::log(lib::log_level::INFO, "sys_munmap called");
+            if (lib::static_branch<alloc_trace>()) {
+                lib::log(lib::log_level::INFO, "sys_munmap called");
+            }
             return -1;
         }
     }
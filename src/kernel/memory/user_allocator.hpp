@@ -13,7 +13,7 @@
  * 0x00400000 - 0x07FFFFFF: Code + Data segments (128MB max)
  * 0x08000000 - 0x3FFFFFFF: Process Heap (768MB max) - Managed by this allocator  
  * 0x40000000 - 0x6FFFFFFF: Shared libraries/mmap (768MB)
- * 0x70000000 - 0x7FFF0000: Reserved
+ * 0x70000000 - 0x7FFF0000: Reserved (vDSO time page at 0x70000000, syscall rings at 0x70100000)
  * 0x7FFF0000 - 0x80000000: User Stack (8MB default, grows down)
  * 0x80000000+            : Kernel space (high memory)
  * 
@@ -48,6 +48,7 @@ namespace memory
     constexpr uintptr_t USER_HEAP_MAX_ADDR     = 0x40000000;   // 1GB - heap limit
     constexpr uintptr_t USER_MMAP_START        = 0x40000000;   // 1GB - shared libs/mmap
     constexpr uintptr_t USER_MMAP_MAX          = 0x70000000;   // 1.75GB - mmap limit
+    constexpr uintptr_t USER_RING_START        = 0x70100000;   // syscall submission rings
     constexpr uintptr_t USER_STACK_TOP         = 0x7FFF0000;   // Near 2GB - stack top
     constexpr size_t    USER_STACK_SIZE        = 8_MB;         // 8MB default stack
     constexpr size_t    USER_HEAP_INITIAL_SIZE = 1_MB;         // 1MB initial heap
@@ -0,0 +1,73 @@
+#include "vdso_page.hpp"
+#include "allocators.hpp"
+
+#include "config.hpp"
+#include "libs/string.hpp"
+
+namespace memory
+{
+    constexpr uint32_t TSC_SHIFT = 32;
+
+    static vdso::time_data *data_ = nullptr;
+    static paddr_t physical_ = nullptr;
+
+    static vdso::time_data *setup()
+    {
+        vaddr_t page = placement_kalloc(FRAME_SIZE, &physical_, true);
+        lib::memset(page, 0, FRAME_SIZE);
+
+        data_ = static_cast<vdso::time_data*>(page);
+        return data_;
+    }
+
+    static void write_begin(vdso::time_data *data)
+    {
+        __atomic_store_n(&data->seq, data->seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+
+    static void write_end(vdso::time_data *data)
+    {
+        __atomic_store_n(&data->seq, data->seq + 1, __ATOMIC_RELEASE);
+    }
+
+    vdso::time_data *vdso_data()
+    {
+        return (data_ != nullptr) ? data_ : setup();
+    }
+
+    paddr_t vdso_physical()
+    {
+        vdso_data();
+        return physical_;
+    }
+
+    void vdso_calibrate(uint32_t frequency, uint64_t tsc_hz, uint64_t tsc)
+    {
+        auto *data = vdso_data();
+
+        write_begin(data);
+        data->frequency   = frequency;
+        data->tsc_hz      = tsc_hz;
+        data->tsc_shift   = TSC_SHIFT;
+        data->tsc_mult    = (tsc_hz != 0) ? (1'000'000'000ull << TSC_SHIFT) / tsc_hz : 0;
+        data->tsc_at_tick = tsc;
+        write_end(data);
+    }
+
+    void vdso_tick(uint64_t ticks, uint64_t tsc)
+    {
+        auto *data = vdso_data();
+
+        write_begin(data);
+        if (data->tsc_mult != 0) {
+            data->ns_at_tick += ((tsc - data->tsc_at_tick) * data->tsc_mult) >> data->tsc_shift;
+        }
+        else if (data->frequency != 0) {
+            data->ns_at_tick += 1'000'000'000ull / data->frequency;
+        }
+        data->ticks       = ticks;
+        data->tsc_at_tick = tsc;
+        write_end(data);
+    }
+}
\ No newline at end of file
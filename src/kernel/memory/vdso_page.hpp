@@ -0,0 +1,26 @@
+#ifndef VDSO_PAGE_HPP
+#define VDSO_PAGE_HPP
+
+#include "libs/stdint.hpp"
+#include "libs/vdso.hpp"
+
+/*
+ * Kernel side of the vDSO time page (see libs/vdso.hpp)
+ *
+ * The page lives in the kernel image area, so the kernel writes it through
+ * its higher-half address while user address spaces get a read-only alias
+ * of the same frame at vdso::USER_VDSO_ADDR.
+ */
+namespace memory
+{
+    vdso::time_data *vdso_data();
+    paddr_t vdso_physical();
+
+    // timer calibration: interrupt frequency and TSC rate
+    void vdso_calibrate(uint32_t frequency, uint64_t tsc_hz, uint64_t tsc);
+
+    // called on every timer interrupt
+    void vdso_tick(uint64_t ticks, uint64_t tsc);
+}
+
+#endif // VDSO_PAGE_HPP
\ No newline at end of file
@@ -0,0 +1,272 @@
+#include "ring.hpp"
+#include "syscall.hpp"
+
+#include "config.hpp"
+#include "arch/amd64/instructions.hpp"
+#include "arch/amd64/memory/paging.hpp"
+#include "libs/logger.hpp"
+#include "libs/string.hpp"
+#include "memory/memory_manager.hpp"
+#include "memory/user_allocator.hpp"
+
+namespace syscall
+{
+    constexpr size_t MAX_RINGS = 16;
+
+    // region size for RING_MAX_ENTRIES, bounds the frames of a ring
+    constexpr size_t MAX_RING_PAGES = (sizeof(ring_header) +
+                                       RING_MAX_ENTRIES * sizeof(ring_sqe) +
+                                       2 * RING_MAX_ENTRIES * sizeof(ring_cqe) +
+                                       FRAME_SIZE - 1) / FRAME_SIZE;
+
+    struct ring_context
+    {
+        paddr_t      page_dir;      // owner address space, nullptr if the slot is free
+        ring_header *header;        // kernel mapping of the shared region
+        ring_sqe    *sqes;
+        ring_cqe    *cqes;
+        vaddr_t      kernel_addr;
+        vaddr_t      user_addr;
+        size_t       size;
+        paddr_t      frames[MAX_RING_PAGES];
+
+        // kernel private copies, the header is writable by user space
+        uint32_t     sq_entries;
+        uint32_t     cq_entries;
+        uint32_t     flags;
+    };
+
+    static ring_context rings_[MAX_RINGS];
+
+    static ring_context *find_ring(paddr_t page_dir)
+    {
+        for (auto &ring : rings_) {
+            if (ring.page_dir == page_dir) {
+                return &ring;
+            }
+        }
+
+        return nullptr;
+    }
+
+    static uint32_t round_up_pow2(uint32_t value)
+    {
+        uint32_t pow2 = 1;
+        while (pow2 < value) {
+            pow2 <<= 1;
+        }
+        return pow2;
+    }
+
+    // Undoes the first pages mappings made by map_shared
+    static void unmap_shared(paddr_t page_dir, vaddr_t kernel_addr, vaddr_t user_addr,
+                             const paddr_t *frames, size_t pages)
+    {
+        paging page_mgr;
+
+        for (size_t i = 0; i < pages; i++) {
+            page_mgr.unmap(ptr_to<vaddr_t>(ptr_from(kernel_addr) + i * FRAME_SIZE));
+            page_mgr.unmap(page_dir, ptr_to<vaddr_t>(ptr_from(user_addr) + i * FRAME_SIZE));
+            memory::g_physical_manager->free(frames[i]);
+        }
+    }
+
+    // Backs [kernel_addr, kernel_addr + size) and [user_addr, user_addr + size)
+    // with the same physical frames, stored in frames. Nothing stays mapped
+    // on failure
+    static bool map_shared(paddr_t page_dir, vaddr_t kernel_addr, vaddr_t user_addr, size_t size,
+                           paddr_t *frames)
+    {
+        paging page_mgr;
+        size_t pages = ALIGN_UP(size) / FRAME_SIZE;
+
+        for (size_t i = 0; i < pages; i++) {
+            paddr_t frame = memory::g_physical_manager->alloc();
+            if (frame == nullptr) {
+                unmap_shared(page_dir, kernel_addr, user_addr, frames, i);
+                return false;
+            }
+
+            vaddr_t kaddr = ptr_to<vaddr_t>(ptr_from(kernel_addr) + i * FRAME_SIZE);
+            vaddr_t uaddr = ptr_to<vaddr_t>(ptr_from(user_addr) + i * FRAME_SIZE);
+
+            if (page_mgr.map(kaddr, frame, 0x03) != 0) {
+                memory::g_physical_manager->free(frame);
+                unmap_shared(page_dir, kernel_addr, user_addr, frames, i);
+                return false;
+            }
+
+            if (page_mgr.map(page_dir, uaddr, frame, 0x07) != 0) {
+                page_mgr.unmap(kaddr);
+                memory::g_physical_manager->free(frame);
+                unmap_shared(page_dir, kernel_addr, user_addr, frames, i);
+                return false;
+            }
+
+            frames[i] = frame;
+        }
+
+        return true;
+    }
+
+    static uint32_t drain(ring_context &ring, uint32_t budget)
+    {
+        ring_header *header = ring.header;
+
+        uint32_t sq_head = header->sq_head;
+        uint32_t sq_tail = __atomic_load_n(&header->sq_tail, __ATOMIC_ACQUIRE);
+        uint32_t cq_tail = header->cq_tail;
+        uint32_t cq_head = __atomic_load_n(&header->cq_head, __ATOMIC_ACQUIRE);
+
+        uint32_t consumed = 0;
+        while (sq_head != sq_tail && consumed < budget) {
+            if (cq_tail - cq_head >= ring.cq_entries) {
+                // user space isn't reaping completions, stop until it does
+                __atomic_or_fetch(&header->flags, RING_CQ_OVERFLOW, __ATOMIC_RELEASE);
+                break;
+            }
+
+            // copy the entry, user space may rewrite the slot concurrently
+            ring_sqe sqe = ring.sqes[sq_head & (ring.sq_entries - 1)];
+
+            int64_t result;
+            if (sqe.number == SYS_RING_SETUP || sqe.number == SYS_RING_ENTER) {
+                result = -EINVAL;
+            }
+            else {
+                result = static_cast<int64_t>(syscall_dispatch(sqe.number,
+                                                               sqe.args[0], sqe.args[1], sqe.args[2],
+                                                               sqe.args[3], sqe.args[4]));
+            }
+
+            ring_cqe &cqe = ring.cqes[cq_tail & (ring.cq_entries - 1)];
+            cqe.user_data = sqe.user_data;
+            cqe.result    = result;
+
+            sq_head++;
+            cq_tail++;
+            consumed++;
+        }
+
+        // publish completions before giving the submission slots back
+        __atomic_store_n(&header->cq_tail, cq_tail, __ATOMIC_RELEASE);
+        __atomic_store_n(&header->sq_head, sq_head, __ATOMIC_RELEASE);
+
+        return consumed;
+    }
+
+    int64_t ring_setup(uint32_t entries, uint32_t flags)
+    {
+        if (entries == 0 || entries > RING_MAX_ENTRIES) {
+            return -EINVAL;
+        }
+
+        paddr_t page_dir = insn::get_current_page();
+        if (find_ring(page_dir) != nullptr) {
+            return -EEXIST;
+        }
+
+        ring_context *ring = find_ring(nullptr);
+        if (ring == nullptr) {
+            return -ENOMEM;
+        }
+
+        uint32_t sq_entries = round_up_pow2(entries);
+        uint32_t cq_entries = sq_entries * 2;
+
+        size_t sq_offset = sizeof(ring_header);
+        size_t cq_offset = sq_offset + sq_entries * sizeof(ring_sqe);
+        size_t size      = ALIGN_UP(cq_offset + cq_entries * sizeof(ring_cqe));
+
+        vaddr_t kernel_addr = memory::g_kernel_virtual_manager->alloc(size);
+        if (kernel_addr == nullptr) {
+            return -ENOMEM;
+        }
+
+        // one ring per address space, so its user address is fixed
+        vaddr_t user_addr = ptr_to<vaddr_t>(memory::USER_RING_START);
+        if (!map_shared(page_dir, kernel_addr, user_addr, size, ring->frames)) {
+            lib::log(lib::log_level::CRITICAL, "Ring: unable to map the shared region");
+            memory::g_kernel_virtual_manager->free(kernel_addr, size);
+            return -ENOMEM;
+        }
+
+        lib::memset(kernel_addr, 0, size);
+
+        ring->page_dir    = page_dir;
+        ring->kernel_addr = kernel_addr;
+        ring->user_addr   = user_addr;
+        ring->size        = size;
+        ring->sq_entries  = sq_entries;
+        ring->cq_entries  = cq_entries;
+        ring->flags       = flags;
+        ring->header      = static_cast<ring_header*>(kernel_addr);
+        ring->sqes        = ptr_to<ring_sqe*>(ptr_from(kernel_addr) + sq_offset);
+        ring->cqes        = ptr_to<ring_cqe*>(ptr_from(kernel_addr) + cq_offset);
+
+        ring->header->sq_entries = sq_entries;
+        ring->header->cq_entries = cq_entries;
+        ring->header->sq_offset  = static_cast<uint32_t>(sq_offset);
+        ring->header->cq_offset  = static_cast<uint32_t>(cq_offset);
+
+        return static_cast<int64_t>(ptr_from(user_addr));
+    }
+
+    void ring_release(paddr_t page_dir)
+    {
+        if (page_dir == nullptr) {
+            return;
+        }
+
+        ring_context *ring = find_ring(page_dir);
+        if (ring == nullptr) {
+            return;
+        }
+
+        // off the poll list first, nothing may drain a ring being unmapped
+        ring->page_dir = nullptr;
+
+        unmap_shared(page_dir, ring->kernel_addr, ring->user_addr, ring->frames,
+                     ring->size / FRAME_SIZE);
+        memory::g_kernel_virtual_manager->free(ring->kernel_addr, ring->size);
+
+        lib::memset(ring, 0, sizeof(ring_context));
+    }
+
+    int64_t ring_enter(uint32_t to_submit)
+    {
+        ring_context *ring = find_ring(insn::get_current_page());
+        if (ring == nullptr) {
+            return -ENXIO;
+        }
+
+        return drain(*ring, to_submit);
+    }
+
+    bool ring_poll()
+    {
+        bool polling = false;
+        paddr_t page_dir = insn::get_current_page();
+
+        for (auto &ring : rings_) {
+            if (ring.page_dir == nullptr || (ring.flags & RING_SETUP_POLL) == 0) {
+                continue;
+            }
+
+            // the entries carry user pointers, run them in the owner's
+            // address space like a SYS_RING_ENTER from that process would
+            if (insn::get_current_page() != ring.page_dir) {
+                insn::set_page_directory(ring.page_dir);
+            }
+
+            drain(ring, ring.sq_entries);
+            polling = true;
+        }
+
+        if (insn::get_current_page() != page_dir) {
+            insn::set_page_directory(page_dir);
+        }
+
+        return polling;
+    }
+}
\ No newline at end of file
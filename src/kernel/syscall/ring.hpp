@@ -0,0 +1,87 @@
+#ifndef RING_HPP
+#define RING_HPP
+
+#include "libs/stdint.hpp"
+
+/*
+ * batched syscall submission ring
+ *
+ * A process sets up one ring with SYS_RING_SETUP and gets back the user
+ * address of a shared region laid out as:
+ *
+ *   +-------------+----------------------------+-------------------------------+
+ *   | ring_header | ring_sqe[entries]          | ring_cqe[2 * entries]         |
+ *   +-------------+----------------------------+-------------------------------+
+ *
+ * User code fills submission entries (sqe) and publishes them by storing
+ * sq_tail with release semantics. The kernel consumes from sq_head, runs
+ * each entry through the regular syscall table and posts a completion
+ * entry (cqe) carrying the same user_data. Many requests then cost one
+ * SYS_RING_ENTER trap, or none at all when the ring was created with
+ * RING_SETUP_POLL and is drained by the kernel poller.
+ *
+ * Index ownership (single producer/single consumer on each queue):
+ *   sq_tail, cq_head: written by user space
+ *   sq_head, cq_tail: written by the kernel
+ */
+namespace syscall
+{
+    constexpr uint32_t RING_MAX_ENTRIES = 256;
+
+    // ring_setup flags
+    constexpr uint32_t RING_SETUP_POLL  = 0x1;
+
+    // ring_header::flags, set by the kernel
+    constexpr uint32_t RING_CQ_OVERFLOW = 0x1;
+
+    struct ring_header
+    {
+        uint32_t sq_head;
+        uint32_t sq_tail;
+        uint32_t cq_head;
+        uint32_t cq_tail;
+
+        uint32_t sq_entries;
+        uint32_t cq_entries;
+        uint32_t flags;
+        uint32_t sq_offset;     // from the start of the region
+        uint32_t cq_offset;
+        uint32_t reserved[7];
+    };
+
+    struct ring_sqe
+    {
+        uint64_t number;
+        uint64_t args[5];
+        uint64_t user_data;
+        uint64_t reserved;
+    };
+
+    struct ring_cqe
+    {
+        uint64_t user_data;
+        int64_t  result;
+    };
+
+    static_assert(sizeof(ring_header) == 64, "ring_header must fill a cache line");
+    static_assert(sizeof(ring_sqe) == 64, "ring_sqe must fill a cache line");
+
+    // SYS_RING_SETUP: returns the user address of the region or a negative error
+    int64_t ring_setup(uint32_t entries, uint32_t flags);
+
+    // SYS_RING_ENTER: drains up to to_submit entries, returns how many were consumed
+    int64_t ring_enter(uint32_t to_submit);
+
+    // Unmaps the ring of page_dir from both sides and frees its frames,
+    // does nothing if that address space has no ring. Address space
+    // teardown must call it before the page directory goes away, the slot
+    // is otherwise never reused
+    void ring_release(paddr_t page_dir);
+
+    // Drains every ring created with RING_SETUP_POLL, each one under its
+    // owner's page directory. Returns false when there's no such ring to
+    // keep polling
+    bool ring_poll();
+}
+
+#endif // RING_HPP
\ No newline at end of file
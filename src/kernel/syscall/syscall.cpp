@@ -0,0 +1,70 @@
+#include "syscall.hpp"
+#include "ring.hpp"
+
+#include "memory/user_allocator.hpp"
+
+using namespace memory::syscalls;
+
+namespace syscall
+{
+    static const handler_t table[SYS_COUNT] = {
+        // SYS_MALLOC
+        [](uint64_t size, uint64_t, uint64_t, uint64_t, uint64_t) -> uint64_t {
+            return ptr_from(sys_malloc(size));
+        },
+
+        // SYS_FREE
+        [](uint64_t ptr, uint64_t, uint64_t, uint64_t, uint64_t) -> uint64_t {
+            sys_free(ptr_to<void*>(ptr));
+            return 0;
+        },
+
+        // SYS_REALLOC
+        [](uint64_t ptr, uint64_t size, uint64_t, uint64_t, uint64_t) -> uint64_t {
+            return ptr_from(sys_realloc(ptr_to<void*>(ptr), size));
+        },
+
+        // SYS_CALLOC
+        [](uint64_t num, uint64_t size, uint64_t, uint64_t, uint64_t) -> uint64_t {
+            return ptr_from(sys_calloc(num, size));
+        },
+
+        // SYS_BRK
+        [](uint64_t addr, uint64_t, uint64_t, uint64_t, uint64_t) -> uint64_t {
+            return static_cast<uint64_t>(sys_brk(ptr_to<void*>(addr)));
+        },
+
+        // SYS_MMAP
+        [](uint64_t addr, uint64_t length, uint64_t prot, uint64_t flags, uint64_t) -> uint64_t {
+            return ptr_from(sys_mmap(ptr_to<void*>(addr), length,
+                                     static_cast<int>(prot), static_cast<int>(flags)));
+        },
+
+        // SYS_MUNMAP
+        [](uint64_t addr, uint64_t length, uint64_t, uint64_t, uint64_t) -> uint64_t {
+            return static_cast<uint64_t>(sys_munmap(ptr_to<void*>(addr), length));
+        },
+
+        // SYS_RING_SETUP
+        [](uint64_t entries, uint64_t flags, uint64_t, uint64_t, uint64_t) -> uint64_t {
+            return static_cast<uint64_t>(ring_setup(static_cast<uint32_t>(entries),
+                                                    static_cast<uint32_t>(flags)));
+        },
+
+        // SYS_RING_ENTER
+        [](uint64_t to_submit, uint64_t, uint64_t, uint64_t, uint64_t) -> uint64_t {
+            return static_cast<uint64_t>(ring_enter(static_cast<uint32_t>(to_submit)));
+        },
+    };
+}
+
+extern "C" uint64_t syscall_dispatch(uint64_t number,
+                                     uint64_t arg1, uint64_t arg2, uint64_t arg3,
+                                     uint64_t arg4, uint64_t arg5)
+{
+    if (number >= syscall::SYS_COUNT) {
+        return static_cast<uint64_t>(-syscall::ENOSYS);
+    }
+
+    return syscall::table[number](arg1, arg2, arg3, arg4, arg5);
+}
\ No newline at end of file
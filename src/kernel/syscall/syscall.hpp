@@ -0,0 +1,50 @@
+#ifndef SYSCALL_HPP
+#define SYSCALL_HPP
+
+#include "libs/stdint.hpp"
+
+/*
+ * system call dispatch
+ *
+ * Both entry points, the SYSCALL instruction (fast path) and the legacy
+ * int 0x80 gate, end up in syscall_dispatch() which indexes the table by
+ * the syscall number. Arguments are passed as raw 64-bit registers and
+ * each table entry converts them to the types expected by the sys_*
+ * implementation.
+ *
+ *   SYSCALL: rax = number, rdi, rsi, rdx, r10, r8 = arguments
+ *   int 0x80: rax = number, rbx, rcx, rdx = arguments
+ *
+ * The result is returned in rax, negative values are errors.
+ */
+namespace syscall
+{
+    enum number : uint64_t
+    {
+        SYS_MALLOC = 0,
+        SYS_FREE,
+        SYS_REALLOC,
+        SYS_CALLOC,
+        SYS_BRK,
+        SYS_MMAP,
+        SYS_MUNMAP,
+        SYS_RING_SETUP,
+        SYS_RING_ENTER,
+
+        SYS_COUNT
+    };
+
+    constexpr int64_t ENXIO  = 6;
+    constexpr int64_t ENOMEM = 12;
+    constexpr int64_t EEXIST = 17;
+    constexpr int64_t EINVAL = 22;
+    constexpr int64_t ENOSYS = 38;
+
+    using handler_t = uint64_t (*)(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t);
+}
+
+extern "C" uint64_t syscall_dispatch(uint64_t number,
+                                     uint64_t arg1, uint64_t arg2, uint64_t arg3,
+                                     uint64_t arg4, uint64_t arg5);
+
+#endif // SYSCALL_HPP
\ No newline at end of file
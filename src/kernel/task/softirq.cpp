@@ -0,0 +1,141 @@
+#include "softirq.hpp"
+#include "workqueue.hpp"
+
+#include "config.hpp"
+#include "arch/amd64/instructions.hpp"
+#include "arch/amd64/percpu.hpp"
+
+// rounds over the pending bitmap before handing over to the worker
+constexpr uint32_t MAX_RESTARTS = 10;
+
+struct softirq_cpu
+{
+    uint32_t pending;
+    bool     running;
+
+    // tasklets waiting for the TASKLET softirq, in scheduling order
+    tasklet_t *head;
+    tasklet_t *tail;
+};
+
+static softirq::handler_t handlers_[softirq::COUNT];
+static softirq_cpu cpus_[MAX_CPUS];
+
+static void run_tasklets()
+{
+    auto &cpu = cpus_[percpu::id()];
+
+    // detach the list so tasklets scheduled meanwhile go to the next round
+    auto flags = insn::irq_save();
+    auto *tasklet = cpu.head;
+    cpu.head = nullptr;
+    cpu.tail = nullptr;
+    insn::irq_restore(flags);
+
+    while (tasklet != nullptr) {
+        auto *next = tasklet->next;
+
+        __atomic_store_n(&tasklet->scheduled, false, __ATOMIC_RELEASE);
+        tasklet->function(tasklet->data);
+
+        tasklet = next;
+    }
+}
+
+void softirq::open(number nr, handler_t handler)
+{
+    if (nr < COUNT) {
+        handlers_[nr] = handler;
+    }
+}
+
+void softirq::raise(number nr)
+{
+    auto flags = insn::irq_save();
+    cpus_[percpu::id()].pending |= 1u << nr;
+    insn::irq_restore(flags);
+}
+
+bool softirq::pending()
+{
+    return cpus_[percpu::id()].pending != 0;
+}
+
+void softirq::setup()
+{
+    open(TASKLET, run_tasklets);
+}
+
+void softirq::run()
+{
+    auto flags = insn::irq_save();
+    auto &cpu = cpus_[percpu::id()];
+
+    if (cpu.running) {
+        insn::irq_restore(flags);
+        return;
+    }
+    cpu.running = true;
+
+    for (uint32_t round = 0; round < MAX_RESTARTS && cpu.pending != 0; round++) {
+        auto pending = cpu.pending;
+        cpu.pending = 0;
+
+        // handlers run with interrupts on, new raises land in cpu.pending
+        insn::sti();
+        for (uint32_t nr = 0; nr < COUNT; nr++) {
+            if ((pending & (1u << nr)) && handlers_[nr] != nullptr) {
+                handlers_[nr]();
+            }
+        }
+        insn::cli();
+    }
+
+    cpu.running = false;
+    bool leftover = cpu.pending != 0;
+    insn::irq_restore(flags);
+
+    if (leftover) {
+        workqueue::kick();
+    }
+}
+
+void softirq::irq_exit()
+{
+    auto &cpu = cpus_[percpu::id()];
+    if (cpu.pending != 0 && !cpu.running) {
+        run();
+    }
+}
+
+void tasklet::init(tasklet_t *tasklet, void (*function)(void *data), void *data)
+{
+    tasklet->next = nullptr;
+    tasklet->function = function;
+    tasklet->data = data;
+    tasklet->scheduled = false;
+}
+
+void tasklet::schedule(tasklet_t *tasklet)
+{
+    auto flags = insn::irq_save();
+
+    if (!tasklet->scheduled) {
+        auto &cpu = cpus_[percpu::id()];
+
+        tasklet->scheduled = true;
+        tasklet->next = nullptr;
+
+        if (cpu.tail != nullptr) {
+            cpu.tail->next = tasklet;
+        }
+        else {
+            cpu.head = tasklet;
+        }
+        cpu.tail = tasklet;
+
+        cpu.pending |= 1u << softirq::TASKLET;
+    }
+
+    insn::irq_restore(flags);
+}
\ No newline at end of file
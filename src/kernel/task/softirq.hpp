@@ -0,0 +1,65 @@
+#ifndef SOFTIRQ_HPP
+#define SOFTIRQ_HPP
+
+#include "libs/stdint.hpp"
+
+/*
+ * Bottom halves
+ *
+ * Interrupt handlers (top halves) only acknowledge the device and raise a
+ * softirq or schedule a tasklet. Pending softirqs are kept in a per-cpu
+ * bitmap and run with interrupts enabled right before the interrupt
+ * returns, at most MAX_RESTARTS rounds; whatever is still pending after
+ * that is left to the worker thread (see workqueue.hpp) so an interrupt
+ * storm can't starve everything else.
+ *
+ *   irq --> top half --> raise(nr) --> irq exit: sti, run handlers, cli
+ *                                                   |
+ *                                                   +--> still pending: worker thread
+ *
+ * Tasklets are one-shot callbacks run from the TASKLET softirq on the cpu
+ * that scheduled them. A tasklet scheduled again before it ran is only
+ * run once.
+ */
+namespace softirq
+{
+    enum number : uint32_t
+    {
+        TIMER,
+        TASKLET,
+        COUNT
+    };
+
+    using handler_t = void (*)();
+
+    void setup();
+    void open(number nr, handler_t handler);
+
+    // safe from interrupt context
+    void raise(number nr);
+    bool pending();
+
+    // runs pending softirqs, bounded; called on interrupt exit and by the worker
+    void run();
+
+    // runs pending softirqs unless the interrupt nested inside one
+    void irq_exit();
+}
+
+struct tasklet_t
+{
+    tasklet_t *next;
+    void (*function)(void *data);
+    void *data;
+    bool scheduled;
+};
+
+namespace tasklet
+{
+    void init(tasklet_t *tasklet, void (*function)(void *data), void *data);
+
+    // safe from interrupt context
+    void schedule(tasklet_t *tasklet);
+}
+
+#endif // SOFTIRQ_HPP
\ No newline at end of file
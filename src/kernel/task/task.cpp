@@ -0,0 +1,299 @@
+#include "task.hpp"
+
+#include "arch/amd64/fpu.hpp"
+#include "arch/amd64/instructions.hpp"
+#include "arch/amd64/percpu.hpp"
+#include "arch/amd64/pmu.hpp"
+#include "libs/logger.hpp"
+#include "libs/string.hpp"
+#include "libs/tunables.hpp"
+#include "memory/allocators.hpp"
+
+// rflags of a new thread: reserved bit 1 and IF
+constexpr uint64_t KTHREAD_RFLAGS = 0x202;
+
+extern "C"
+{
+    void context_switch(uint64_t *old_rsp, uint64_t new_rsp);
+    void kthread_trampoline();
+
+    void kthread_exit()
+    {
+        get_task_manager().exit();
+    }
+}
+
+task_manager::task_manager() : current_(nullptr), idle_(nullptr), next_pid_(1)
+{
+}
+
+task_manager::~task_manager()
+{
+}
+
+static task_t *alloc_task(uint64_t pid, uint64_t ppid)
+{
+    auto *task = static_cast<task_t*>(memory::kmalloc(sizeof(task_t)));
+    if (task == nullptr) {
+        return nullptr;
+    }
+
+    lib::memset(task, 0, sizeof(task_t));
+    task->pid = pid;
+    task->ppid = ppid;
+
+    // the #NM handler saves the registers here when the task loses them
+    task->fpu_state = fpu::create_state();
+    if (task->fpu_state == nullptr) {
+        memory::kfree(task);
+        return nullptr;
+    }
+
+    return task;
+}
+
+static void free_task(task_t *task)
+{
+    fpu::release(task);
+    fpu::destroy_state(task->fpu_state);
+    memory::kfree(task->kernel_stack);
+    memory::kfree(task);
+}
+
+void task_manager::init()
+{
+    if (idle_ != nullptr) {
+        return;
+    }
+
+    // the running boot context becomes the idle task, its registers are
+    // saved by the first switch away from it
+    idle_ = alloc_task(0, 0);
+    idle_->state = task_t::state_t::RUNNING;
+    idle_->kernel_stack_top = percpu::get()->kernel_stack;
+    idle_->next = idle_;
+
+    current_ = idle_;
+}
+
+void task_manager::create_task(uint64_t pid, uint64_t ppid)
+{
+    init();
+
+    auto *task = alloc_task(pid, ppid);
+    if (task == nullptr) {
+        lib::log(lib::log_level::ERROR, "Task: unable to allocate task");
+        return;
+    }
+
+    // no context yet, stays off the run queue until someone sets it up
+    task->state = task_t::state_t::BLOCKED;
+
+    auto flags = insn::irq_save();
+    task->next = current_->next;
+    current_->next = task;
+    insn::irq_restore(flags);
+}
+
+void task_manager::destroy_task(uint64_t pid)
+{
+    if (idle_ == nullptr) {
+        return;
+    }
+
+    auto flags = insn::irq_save();
+
+    for (auto *prev = idle_; prev->next != idle_; prev = prev->next) {
+        auto *task = prev->next;
+        if (task->pid != pid) {
+            continue;
+        }
+
+        // a task can't free the stack it's running on
+        if (task == current_) {
+            break;
+        }
+
+        prev->next = task->next;
+        insn::irq_restore(flags);
+
+        free_task(task);
+        return;
+    }
+
+    insn::irq_restore(flags);
+}
+
+void task_manager::reap()
+{
+    auto flags = insn::irq_save();
+
+    auto *prev = idle_;
+    while (prev->next != idle_) {
+        auto *task = prev->next;
+
+        // the exiting task is still on its stack until it switches away
+        if (task->state != task_t::state_t::ZOMBIE || task == current_) {
+            prev = task;
+            continue;
+        }
+
+        prev->next = task->next;
+        insn::irq_restore(flags);
+
+        free_task(task);
+        flags = insn::irq_save();
+    }
+
+    insn::irq_restore(flags);
+}
+
+task_t *task_manager::create_kernel_thread(kthread_entry_t entry, void *arg)
+{
+    init();
+
+    auto *task = alloc_task(next_pid_++, current_->pid);
+    if (task == nullptr) {
+        return nullptr;
+    }
+
+    auto stack_size = lib::tunables::get<size_t>(lib::tunables::KTHREAD_STACK_SIZE);
+    task->kernel_stack = memory::kmalloc(stack_size);
+    if (task->kernel_stack == nullptr) {
+        fpu::destroy_state(task->fpu_state);
+        memory::kfree(task);
+        return nullptr;
+    }
+
+    // initial frame popped by context_switch: rflags, r15, r14, r13, r12,
+    // rbx, rbp and the return address. The trampoline must start with a
+    // 16-byte aligned stack to call entry as the ABI expects.
+    auto top = (ptr_from(task->kernel_stack) + stack_size) & ~0xfull;
+    task->kernel_stack_top = top;
+    auto *stack = ptr_to<uint64_t*>(top - 16);
+
+    *--stack = ptr_from(&kthread_trampoline);
+    *--stack = 0;                       // rbp
+    *--stack = 0;                       // rbx
+    *--stack = ptr_from(entry);         // r12
+    *--stack = ptr_from(arg);           // r13
+    *--stack = 0;                       // r14
+    *--stack = 0;                       // r15
+    *--stack = KTHREAD_RFLAGS;
+
+    task->context.rsp = ptr_from(stack);
+    task->state = task_t::state_t::RUNNING;
+
+    auto flags = insn::irq_save();
+    task->next = current_->next;
+    current_->next = task;
+    insn::irq_restore(flags);
+
+    return task;
+}
+
+task_t *task_manager::current() const
+{
+    return current_;
+}
+
+task_t *task_manager::idle_task() const
+{
+    return idle_;
+}
+
+bool task_manager::idle() const
+{
+    if (idle_ == nullptr) {
+        return true;
+    }
+
+    for (auto *task = idle_->next; task != idle_; task = task->next) {
+        if (task->state == task_t::state_t::RUNNING) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void task_manager::schedule()
+{
+    if (current_ == nullptr) {
+        return;
+    }
+
+    auto flags = insn::irq_save();
+
+    // round robin, the idle task is always runnable
+    auto *next = current_->next;
+    while (next != current_ && next->state != task_t::state_t::RUNNING) {
+        next = next->next;
+    }
+
+    if (next->state != task_t::state_t::RUNNING) {
+        next = idle_;
+    }
+
+    if (next == current_) {
+        insn::irq_restore(flags);
+        return;
+    }
+
+    switch_context(current_, next);
+    insn::irq_restore(flags);
+
+    // back on this task: whoever exited before the switch is off its stack
+    reap();
+}
+
+void task_manager::switch_context(task_t *old_task, task_t *new_task)
+{
+    current_ = new_task;
+    percpu::set_kernel_stack(new_task->kernel_stack_top);
+    fpu::switch_to(new_task);
+    pmu::switch_to(old_task, new_task);
+
+    context_switch(&old_task->context.rsp, new_task->context.rsp);
+}
+
+void task_manager::yield()
+{
+    schedule();
+}
+
+void task_manager::block()
+{
+    if (current_ == idle_) {
+        return;
+    }
+
+    current_->state = task_t::state_t::BLOCKED;
+    schedule();
+}
+
+void task_manager::wake(task_t *task)
+{
+    if (task != nullptr && task->state == task_t::state_t::BLOCKED) {
+        task->state = task_t::state_t::RUNNING;
+    }
+}
+
+void task_manager::exit()
+{
+    insn::cli();
+
+    // reap() frees it once somebody else is running
+    current_->state = task_t::state_t::ZOMBIE;
+    schedule();
+
+    while (true) {
+        insn::hlt();
+    }
+}
+
+task_manager &get_task_manager()
+{
+    static task_manager instance;
+    return instance;
+}
\ No newline at end of file
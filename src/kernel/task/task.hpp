@@ -18,6 +18,8 @@ struct task_t {
 
     paddr_t cr3;
     vaddr_t kernel_stack;
+    // where syscalls and ring 3 interrupts land while this task runs
+    uint64_t kernel_stack_top;
     vaddr_t user_stack;
 
     struct context_t {
@@ -26,10 +28,36 @@ struct task_t {
         uint64_t rip, cs, flags, rsp, ss;
     } context;
 
+    // x87/SSE/AVX state, switched lazily (see arch/amd64/fpu.hpp)
+    void *fpu_state;
+
+    // hardware events counted while this task ran (see arch/amd64/pmu.hpp)
+    uint64_t pmu_counts[4];
+
     task_t *next;
 };
 
+using kthread_entry_t = void (*)(void *arg);
+
+/*
+ * Cooperative scheduler
+ *
+ * Tasks live in a circular list and run until they yield() or block();
+ * interrupts only change states (wake()), the switch itself happens at
+ * the next yield. The boot context (kmain) becomes the idle task in
+ * init() and never blocks, so there is always something to run.
+ *
+ * Kernel threads keep their saved stack pointer in context.rsp, the
+ * other registers are on their own stack (see context.S).
+ */
 class task_manager {
+    task_t *current_;
+    task_t *idle_;
+    uint64_t next_pid_;
+
+    // frees the tasks that exited, except the one running
+    void reap();
+
 public:
     task_manager();
     ~task_manager();
@@ -39,6 +67,24 @@ public:
     void destroy_task(uint64_t pid);
     void schedule();
     void switch_context(task_t *old_task, task_t *new_task);
+
+    task_t *create_kernel_thread(kthread_entry_t entry, void *arg);
+    task_t *current() const;
+    task_t *idle_task() const;
+
+    // true when nothing but the idle task is runnable
+    bool idle() const;
+
+    void yield();
+
+    // must be called with interrupts disabled, after the condition being
+    // waited for was checked, so a wake() from an interrupt can't be lost
+    void block();
+    void wake(task_t *task);
+
+    [[noreturn]] void exit();
 };
 
+task_manager &get_task_manager();
+
 #endif // TASK_H
\ No newline at end of file
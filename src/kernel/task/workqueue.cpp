@@ -0,0 +1,99 @@
+#include "workqueue.hpp"
+#include "softirq.hpp"
+#include "task.hpp"
+
+#include "arch/amd64/instructions.hpp"
+#include "libs/logger.hpp"
+
+static work_t *head_ = nullptr;
+static work_t *tail_ = nullptr;
+static task_t *worker_ = nullptr;
+
+static work_t *pop()
+{
+    auto flags = insn::irq_save();
+
+    auto *work = head_;
+    if (work != nullptr) {
+        head_ = work->next;
+        if (head_ == nullptr) {
+            tail_ = nullptr;
+        }
+
+        // cleared before running so the function may queue it again
+        work->queued = false;
+    }
+
+    insn::irq_restore(flags);
+    return work;
+}
+
+static void worker(void *)
+{
+    auto &tasks = get_task_manager();
+
+    while (true) {
+        softirq::run();
+
+        for (auto *work = pop(); work != nullptr; work = pop()) {
+            work->function(work);
+        }
+
+        // re-check with interrupts off, a wake() in between would be lost
+        auto flags = insn::irq_save();
+        if (head_ == nullptr && !softirq::pending()) {
+            tasks.block();
+        }
+        insn::irq_restore(flags);
+    }
+}
+
+void workqueue::setup()
+{
+    if (worker_ != nullptr) {
+        return;
+    }
+
+    worker_ = get_task_manager().create_kernel_thread(worker, nullptr);
+    if (worker_ == nullptr) {
+        lib::log(lib::log_level::CRITICAL, "Workqueue: unable to create the worker thread");
+    }
+}
+
+void workqueue::init(work_t *work, void (*function)(work_t *work))
+{
+    work->next = nullptr;
+    work->function = function;
+    work->queued = false;
+}
+
+bool workqueue::queue(work_t *work)
+{
+    auto flags = insn::irq_save();
+
+    if (work->queued) {
+        insn::irq_restore(flags);
+        return false;
+    }
+
+    work->queued = true;
+    work->next = nullptr;
+
+    if (tail_ != nullptr) {
+        tail_->next = work;
+    }
+    else {
+        head_ = work;
+    }
+    tail_ = work;
+
+    insn::irq_restore(flags);
+
+    kick();
+    return true;
+}
+
+void workqueue::kick()
+{
+    get_task_manager().wake(worker_);
+}
\ No newline at end of file
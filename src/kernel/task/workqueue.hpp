@@ -0,0 +1,36 @@
+#ifndef WORKQUEUE_HPP
+#define WORKQUEUE_HPP
+
+#include "libs/stdint.hpp"
+
+/*
+ * Work queue
+ *
+ * Work items run in a dedicated kernel thread, with interrupts enabled and
+ * allowed to block, in the order they were queued. The same thread picks
+ * up softirqs left pending by the bounded loop on interrupt exit.
+ *
+ * A work item queued again before it ran is only run once; the item may
+ * be queued again from its own function.
+ */
+struct work_t
+{
+    work_t *next;
+    void (*function)(work_t *work);
+    bool queued;
+};
+
+namespace workqueue
+{
+    void setup();
+
+    void init(work_t *work, void (*function)(work_t *work));
+
+    // safe from interrupt context, returns false if it was already queued
+    bool queue(work_t *work);
+
+    // wakes the worker thread
+    void kick();
+}
+
+#endif // WORKQUEUE_HPP
\ No newline at end of file
@@ -0,0 +1,263 @@
+#include "shim.hpp"
+
+#include "libs/new.hpp"
+#include "memory/heap.hpp"
+#include "memory/memory_manager.hpp"
+#include "memory/user_allocator.hpp"
+
+/*
+ * Allocation pattern benchmarks for memory::heap and memory::user_allocator
+ *
+ *   churn     a window of live blocks, each op frees a random one and
+ *             allocates a new random size in its place
+ *   fragment  fills the heap, frees every other block, then allocates
+ *             blocks bigger than the holes left behind
+ *   realloc   a set of buffers growing in small steps, round robin
+ *
+ * Every run starts from a fresh allocator. Footprint is what the
+ * allocator mapped, live is what the caller asked for, their ratio is
+ * the fragmentation (1.00 would be a perfect fit).
+ */
+
+constexpr size_t PHYSICAL_BYTES = 1_GB;
+
+constexpr size_t CHURN_OPS   = 100'000;
+constexpr size_t CHURN_SLOTS = 512;
+
+constexpr size_t FRAGMENT_BLOCKS = 4096;
+
+constexpr size_t REALLOC_BUFFERS = 64;
+constexpr size_t REALLOC_STEP    = 64;
+constexpr size_t REALLOC_LIMIT   = 64_KB;
+
+// fixed seed, runs are comparable across builds
+class xorshift
+{
+    uint64_t state_ = 0x9e3779b97f4a7c15ull;
+
+public:
+    uint64_t next()
+    {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        return state_;
+    }
+
+    size_t range(size_t min, size_t max)
+    {
+        return min + next() % (max - min + 1);
+    }
+};
+
+// memory::heap as set up by init_kernel_heap, above the host's addresses
+class kernel_heap
+{
+    virt vm_;
+    memory::heap heap_;
+
+    static vaddr_t reserve(virt &vm, size_t size)
+    {
+        vm.alloc(shim::HOST_VIRTUAL_BASE);
+        return vm.alloc(size);
+    }
+
+public:
+    static constexpr const char *NAME = "heap";
+
+    kernel_heap() :
+        heap_(memory::g_physical_manager, &vm_, reserve(vm_, 1_MB), 1_MB)
+    {
+    }
+
+    void *malloc(size_t size)             { return heap_.malloc(size); }
+    void free(void *ptr)                  { heap_.free(ptr); }
+    void *realloc(void *ptr, size_t size) { return heap_.realloc(ptr, size); }
+
+    size_t footprint() const { return heap_.get_total_size(); }
+    bool validate() const    { return heap_.validate_heap(); }
+};
+
+class user_heap
+{
+    memory::user_allocator heap_;
+
+public:
+    static constexpr const char *NAME = "user_allocator";
+
+    user_heap() :
+        heap_(nullptr)
+    {
+    }
+
+    void *malloc(size_t size)             { return heap_.malloc(size); }
+    void free(void *ptr)                  { heap_.free(ptr); }
+    void *realloc(void *ptr, size_t size) { return heap_.realloc(ptr, size); }
+
+    size_t footprint() const { return heap_.get_heap_size(); }
+    bool validate() const    { return heap_.validate_heap(); }
+};
+
+// runs whose validate_heap() failed, any makes the exit status non zero
+static size_t failures_;
+
+struct block
+{
+    void  *ptr;
+    size_t size;
+};
+
+template <typename Allocator>
+static void report(const Allocator &allocator, const char *pattern, uint64_t elapsed,
+                   size_t ops, size_t live)
+{
+    size_t footprint = allocator.footprint();
+    size_t kb = 1_KB;
+    bool valid = allocator.validate();
+
+    if (!valid) {
+        failures_++;
+    }
+
+    printf("%-16s %-10s %10.1f ns/op   footprint %8zu KB   live %8zu KB   ratio %6.2f%s\n",
+           Allocator::NAME, pattern,
+           static_cast<double>(elapsed) / static_cast<double>(ops),
+           footprint / kb, live / kb,
+           live == 0 ? 0.0 : static_cast<double>(footprint) / static_cast<double>(live),
+           valid ? "" : "   (validate_heap failed)");
+}
+
+template <typename Allocator>
+static void churn()
+{
+    static block slots[CHURN_SLOTS];
+
+    Allocator allocator;
+    xorshift rng;
+    size_t live = 0;
+
+    for (auto &slot : slots) {
+        slot.size = rng.range(16, 1024);
+        slot.ptr = allocator.malloc(slot.size);
+        live += slot.size;
+    }
+
+    auto start = shim::now_ns();
+
+    for (size_t i = 0; i < CHURN_OPS; i++) {
+        auto &slot = slots[rng.next() % CHURN_SLOTS];
+
+        allocator.free(slot.ptr);
+        live -= slot.size;
+
+        slot.size = rng.range(16, 1024);
+        slot.ptr = allocator.malloc(slot.size);
+        live += slot.size;
+    }
+
+    report(allocator, "churn", shim::now_ns() - start, CHURN_OPS, live);
+
+    for (auto &slot : slots) {
+        allocator.free(slot.ptr);
+    }
+}
+
+template <typename Allocator>
+static void fragment()
+{
+    static block blocks[FRAGMENT_BLOCKS];
+
+    Allocator allocator;
+    xorshift rng;
+    size_t live = 0;
+    size_t ops = 0;
+
+    auto start = shim::now_ns();
+
+    for (auto &b : blocks) {
+        b.size = rng.range(16, 2048);
+        b.ptr = allocator.malloc(b.size);
+        live += b.size;
+        ops++;
+    }
+
+    for (size_t i = 0; i < FRAGMENT_BLOCKS; i += 2) {
+        allocator.free(blocks[i].ptr);
+        live -= blocks[i].size;
+        ops++;
+    }
+
+    // the holes are at most 2KB, none of these fit in them
+    for (size_t i = 0; i < FRAGMENT_BLOCKS; i += 2) {
+        blocks[i].size = rng.range(2049, 4096);
+        blocks[i].ptr = allocator.malloc(blocks[i].size);
+        live += blocks[i].size;
+        ops++;
+    }
+
+    report(allocator, "fragment", shim::now_ns() - start, ops, live);
+
+    for (auto &b : blocks) {
+        allocator.free(b.ptr);
+    }
+}
+
+template <typename Allocator>
+static void realloc_growth()
+{
+    static block buffers[REALLOC_BUFFERS];
+
+    Allocator allocator;
+    size_t ops = 0;
+
+    for (auto &buffer : buffers) {
+        buffer = { nullptr, 0 };
+    }
+
+    auto start = shim::now_ns();
+
+    for (size_t size = REALLOC_STEP; size <= REALLOC_LIMIT; size += REALLOC_STEP) {
+        for (auto &buffer : buffers) {
+            void *grown = allocator.realloc(buffer.ptr, size);
+            if (grown == nullptr) {
+                continue;
+            }
+
+            buffer = { grown, size };
+            ops++;
+        }
+    }
+
+    size_t live = 0;
+    for (auto &buffer : buffers) {
+        live += buffer.size;
+    }
+
+    report(allocator, "realloc", shim::now_ns() - start, ops, live);
+
+    for (auto &buffer : buffers) {
+        allocator.free(buffer.ptr);
+    }
+}
+
+template <typename Allocator>
+static void run()
+{
+    churn<Allocator>();
+    fragment<Allocator>();
+    realloc_growth<Allocator>();
+}
+
+int main()
+{
+    shim::setup(PHYSICAL_BYTES);
+
+    run<kernel_heap>();
+    run<user_heap>();
+
+    if (shim::critical_logs() > 0) {
+        printf("%zu critical log records\n", shim::critical_logs());
+    }
+
+    return (failures_ > 0 || shim::critical_logs() > 0) ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "shim.hpp"
+
+#include "config.hpp"
+#include "libs/logger.hpp"
+#include "libs/new.hpp"
+#include "memory/allocators.hpp"
+#include "memory/memory_manager.hpp"
+#include "arch/amd64/memory/paging.hpp"
+
+constexpr int PROT_READ_WRITE     = 0x3;
+constexpr int MAP_PRIVATE_ANON    = 0x22;
+constexpr int MAP_FIXED_NOREPLACE = 0x100000;
+constexpr int CLOCK_MONOTONIC     = 1;
+
+constexpr size_t ARENA_SIZE = 256_MB;
+
+// physical addresses handed to 'physical', never touched
+constexpr uintptr_t FAKE_PHYSICAL_START = 1_MB;
+
+struct host_timespec
+{
+    long tv_sec;
+    long tv_nsec;
+};
+
+extern "C" int clock_gettime(int clock, host_timespec *ts);
+
+static uintptr_t arena_;
+static uintptr_t placement_;
+static uintptr_t arena_end_;
+
+static size_t critical_logs_;
+static size_t mapped_pages_;
+
+namespace memory
+{
+    physical *g_physical_manager = nullptr;
+}
+
+vaddr_t placement_kalloc(size_t size, paddr_t *paddr, bool align/*=false*/)
+{
+    if (align) {
+        placement_ = ALIGN_UP(placement_);
+    }
+
+    if (placement_ + size > arena_end_) {
+        printf("membench: placement arena exhausted\n");
+        return nullptr;
+    }
+
+    auto *ret = ptr_to<vaddr_t>(placement_);
+    *paddr = ret;
+    placement_ += size;
+
+    return ret;
+}
+
+vaddr_t placement_kalloc(size_t size, bool align/*=false*/)
+{
+    paddr_t tmp;
+    return placement_kalloc(size, &tmp, align);
+}
+
+void kfree_block(size_t size)
+{
+    placement_ -= size;
+}
+
+int paging::map(paddr_t, vaddr_t vaddr, paddr_t, uint8_t)
+{
+    void *page = mmap(vaddr, FRAME_SIZE, PROT_READ_WRITE,
+                      MAP_PRIVATE_ANON | MAP_FIXED_NOREPLACE, -1, 0);
+    if (page != vaddr) {
+        // either taken by the host or an old kernel without NOREPLACE
+        if (page != ptr_to<void*>(~0ull)) {
+            munmap(page, FRAME_SIZE);
+        }
+        return -1;
+    }
+
+    mapped_pages_++;
+    return 0;
+}
+
+int paging::map(vaddr_t vaddr, paddr_t paddr, uint8_t flags)
+{
+    return map(nullptr, vaddr, paddr, flags);
+}
+
+void paging::unmap(paddr_t, vaddr_t vaddr)
+{
+    if (munmap(vaddr, FRAME_SIZE) == 0) {
+        mapped_pages_--;
+    }
+}
+
+void paging::unmap(vaddr_t vaddr)
+{
+    unmap(nullptr, vaddr);
+}
+
+void lib::logger::submit(const log_record &record)
+{
+    if (record.level == log_level::CRITICAL) {
+        critical_logs_++;
+    }
+}
+
+void shim::setup(size_t physical_bytes)
+{
+    void *arena = mmap(nullptr, ARENA_SIZE, PROT_READ_WRITE, MAP_PRIVATE_ANON, -1, 0);
+    if (arena == ptr_to<void*>(~0ull)) {
+        printf("membench: unable to map the placement arena\n");
+        return;
+    }
+
+    arena_ = ptr_from(arena);
+    placement_ = arena_;
+    arena_end_ = arena_ + ARENA_SIZE;
+
+    auto *place = placement_kalloc(sizeof(physical), true);
+    memory::g_physical_manager = new (place) physical();
+    memory::g_physical_manager->setup(ptr_to<paddr_t>(FAKE_PHYSICAL_START), physical_bytes);
+}
+
+uint64_t shim::now_ns()
+{
+    host_timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000ull + ts.tv_nsec;
+}
+
+size_t shim::critical_logs()
+{
+    return critical_logs_;
+}
+
+size_t shim::mapped_pages()
+{
+    return mapped_pages_;
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef SHIM_HPP
+#define SHIM_HPP
+
+#include "libs/stdint.hpp"
+
+/*
+ * Host stand-ins for the kernel services the memory classes depend on
+ *
+ *   placement_kalloc   bump allocator over an anonymous host mapping
+ *   paging             map() backs the virtual page with a host page at
+ *                      the same address, physical addresses are ignored
+ *   lib::log           records are counted, not formatted
+ *
+ * Physical frames are fake addresses handed out by the real 'physical'
+ * class, nothing ever dereferences them on the host.
+ */
+
+// libc, declared here because its headers clash with libs/stdint.hpp
+extern "C" {
+    void *mmap(void *addr, size_t length, int prot, int flags, int fd, long offset);
+    int munmap(void *addr, size_t length);
+    int printf(const char *format, ...);
+}
+
+namespace shim
+{
+    // virtual addresses below this are left to the host process
+    constexpr uintptr_t HOST_VIRTUAL_BASE = 64_GB;
+
+    void setup(size_t physical_bytes);
+
+    uint64_t now_ns();
+
+    size_t critical_logs();
+    size_t mapped_pages();
+}
+
+#endif // SHIM_HPP
\ No newline at end of file
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""
+Folds the samples lib::profiler::dump() prints on COM1 into stacks.
+
+    ./symbolize.py build/debug/coronel.sym serial.log > kernel.folded
+    flamegraph.pl kernel.folded > kernel.svg
+
+coronel.sym is the objdump -t output the build writes next to the ISO.
+Every "sample <rip> <callers...>" line becomes one "outer;...;inner"
+stack, identical stacks are counted once with their number of samples.
+The output is the folded format read by flamegraph.pl and speedscope.
+"""
+
+import bisect
+import shutil
+import subprocess
+import sys
+
+
+def load_symbols(path):
+    symbols = []
+
+    with open(path) as sym:
+        for line in sym:
+            fields = line.split()
+            # address flags... section size name, functions only
+            if len(fields) < 5 or 'F' not in fields[1:-3]:
+                continue
+
+            try:
+                address = int(fields[0], 16)
+                size = int(fields[-2], 16)
+            except ValueError:
+                continue
+
+            symbols.append((address, size, fields[-1]))
+
+    symbols.sort()
+    return symbols
+
+
+def demangle(names):
+    cxxfilt = shutil.which('c++filt')
+    if cxxfilt is None or not names:
+        return {name: name for name in names}
+
+    result = subprocess.run([cxxfilt], input='\n'.join(names), capture_output=True, text=True)
+    return dict(zip(names, result.stdout.splitlines()))
+
+
+def resolve(symbols, starts, address):
+    index = bisect.bisect_right(starts, address) - 1
+    if index < 0:
+        return None
+
+    start, size, name = symbols[index]
+    if size != 0 and address >= start + size:
+        return None
+
+    return name
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('usage: symbolize.py coronel.sym serial.log')
+
+    symbols = load_symbols(sys.argv[1])
+    starts = [symbol[0] for symbol in symbols]
+
+    stacks = {}
+    with open(sys.argv[2], errors='replace') as log:
+        for line in log:
+            fields = line.split()
+            if len(fields) < 2 or fields[0] != 'sample':
+                continue
+
+            frames = []
+            for depth, field in enumerate(fields[1:]):
+                address = int(field, 16)
+                # return addresses point past the call, look up the call
+                if depth > 0:
+                    address -= 1
+
+                name = resolve(symbols, starts, address)
+                frames.append(name if name is not None else '0x%x' % address)
+
+            key = tuple(reversed(frames))
+            stacks[key] = stacks.get(key, 0) + 1
+
+    names = sorted({frame for stack in stacks for frame in stack})
+    pretty = demangle(names)
+
+    for stack, count in sorted(stacks.items(), key=lambda item: -item[1]):
+        print('%s %d' % (';'.join(pretty[frame] for frame in stack), count))
+
+
+if __name__ == '__main__':
+    main()
\ No newline at end of file